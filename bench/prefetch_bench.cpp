@@ -0,0 +1,89 @@
+/**
+ * Benchmark for the prefetch-ahead pipeline of SingleThreadSampler.
+ *
+ * Builds a random Boolean factor graph in memory, much larger than the
+ * last-level cache, with pairwise factors between uniformly random variables,
+ * and times single-threaded inference sweeps for several prefetch distances.
+ * Without hardware counters, the time per variable stands in for the stall
+ * cycles: the arithmetic per variable does not change with the distance, so
+ * any difference is time spent waiting on memory.
+ *
+ * Usage: dw_bench [n_var] [factors_per_var] [n_sweep]
+ */
+
+#include "dstruct/factor_graph/factor_graph.h"
+#include "app/gibbs/single_thread_sampler.h"
+#include "app/gibbs/variable_schedule.h"
+#include "timer.h"
+#include <stdlib.h>
+#include <iostream>
+
+using namespace dd;
+
+// builds a graph of n_var Boolean query variables, n_var * factors_per_var / 2
+// pairwise AND/EQUAL/IMPLY factors over random variables, and 1024 weights
+static void build_random_graph(FactorGraph & fg, long n_var, long n_factor, long n_weight){
+  unsigned short seed[3] = {1, 2, 3};
+  for(long i=0;i<n_var;i++){
+    fg.variables[i] = Variable(i, DTYPE_BOOLEAN, false, 0, 1, 0, false);
+    fg.c_nvar++;
+    fg.n_query++;
+  }
+  for(long i=0;i<n_weight;i++){
+    fg.weights[i] = Weight(i, erand48(seed) - 0.5, false);
+    fg.c_nweight++;
+  }
+  static const int funcs[3] = {FUNC_AND, FUNC_EQUAL, FUNC_IMPLY_MLN};
+  for(long i=0;i<n_factor;i++){
+    fg.factors[i] = Factor(i, (long)(erand48(seed) * n_weight), funcs[i % 3], 2);
+    for(int pos=0;pos<2;pos++){
+      const long vid = (long)(erand48(seed) * n_var);
+      fg.factors[i].tmp_variables.push_back(VariableInFactor(vid, 1, vid, pos, true));
+    }
+    fg.c_nfactor++;
+  }
+  fg.sort_by_id();
+  for(long i=0;i<n_var;i++){
+    fg.infrs->assignments_evid[i] = erand48(seed) < 0.5;
+  }
+  fg.organize_graph_by_edge();
+  fg.safety_check();
+}
+
+int main(int argc, char ** argv){
+  const long n_var = argc > 1 ? atol(argv[1]) : 4000000;
+  const long factors_per_var = argc > 2 ? atol(argv[2]) : 4;
+  const int n_sweep = argc > 3 ? atoi(argv[3]) : 5;
+  const long n_factor = n_var * factors_per_var / 2;
+  const long n_weight = 1024;
+
+  FactorGraph fg(n_var, n_factor, n_weight, n_factor * 2);
+  build_random_graph(fg, n_var, n_factor, n_weight);
+  std::cout << "GRAPH: " << n_var << " variables, " << n_factor << " factors, "
+            << fg.c_edge << " edges" << std::endl;
+
+  VariableSchedule schedule;
+  schedule.build_inference(fg, false, 1);
+
+  const int distances[] = {0, 2, 4, 8, 16};
+  double baseline = 0;
+  for(int d : distances){
+    fg.prefetch_distance = d;
+    SingleThreadSampler sampler(&fg, false, false, false);
+    // warm up page tables and caches once
+    sampler.sample(schedule, 0);
+    // the fastest sweep is the least disturbed by other processes
+    double best = -1;
+    for(int s=0;s<n_sweep;s++){
+      Timer t;
+      sampler.sample(schedule, 0);
+      const double elapsed = t.elapsed();
+      if(best < 0 || elapsed < best) best = elapsed;
+    }
+    const double ns = best * 1e9 / n_var;
+    if(d == 0) baseline = ns;
+    std::cout << "PREFETCH DISTANCE " << d << ": " << ns << " ns/variable, "
+              << 100.0 * (baseline - ns) / baseline << "% less than no prefetch" << std::endl;
+  }
+  return 0;
+}
@@ -23,8 +23,7 @@ dd::ExpMax::ExpMax(FactorGraph * const _p_fg, GibbsSampling * const _gibbs, int
 
     //Store initial weights
     for(long t=0;t<p_fg->n_weight;t++){
-        const Weight & weight = p_fg->weights[t];
-        old_weight_values[weight.id] = weight.weight;
+        old_weight_values[t] = p_fg->infrs->weight_values[t];
     }
 
     //Initialize convergence flag
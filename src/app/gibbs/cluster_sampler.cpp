@@ -0,0 +1,119 @@
+#include "app/gibbs/cluster_sampler.h"
+#include <stdlib.h>
+
+dd::ClusterSampler::ClusterSampler(FactorGraph * _p_fg, bool sample_evidence) :
+  p_fg(_p_fg), sample_evidence(sample_evidence), n_clusters(0), n_flipped(0) {
+  p_rand_seed[0] = rand();
+  p_rand_seed[1] = rand();
+  p_rand_seed[2] = rand();
+}
+
+void dd::ClusterSampler::sample(){
+  const long n_var = p_fg->n_var;
+  parent.resize(n_var);
+  for(long i=0;i<n_var;i++){
+    parent[i] = i;
+  }
+
+  // activate the bond factors whose variables agree, each seen from its
+  // first variable
+  for(long v=0;v<n_var;v++){
+    const Variable & variable = p_fg->variables[v];
+    for(long i=variable.n_start_i_factors;i<variable.n_start_i_factors+variable.n_factors;i++){
+      const CompactFactor & factor = p_fg->compact_factors[i];
+      if(p_fg->vifs[factor.n_start_i_vif].vid != v) continue;
+      const double w = bond_weight(i);
+      if(w <= 0 || p_fg->template potential<false>(factor) == 0) continue;
+      if(erand48(p_rand_seed) >= 1 - exp(-w)) continue;
+      const long root = find(v);
+      for(long j=factor.n_start_i_vif+1;j<factor.n_start_i_vif+factor.n_variables;j++){
+        const long other = find(p_fg->vifs[j].vid);
+        if(other != root) parent[other] = root;
+      }
+    }
+  }
+
+  // group the variables by cluster, clusters with a fixed variable stay
+  std::vector<long> start(n_var + 1, 0);
+  std::vector<bool> is_frozen(n_var, false);
+  for(long v=0;v<n_var;v++){
+    const Variable & variable = p_fg->variables[v];
+    const long root = find(v);
+    start[root + 1] ++;
+    if(variable.domain_type != DTYPE_BOOLEAN || variable.is_observation ||
+      (variable.is_evid && !sample_evidence)){
+      is_frozen[root] = true;
+    }
+  }
+  for(long v=0;v<n_var;v++){
+    start[v + 1] += start[v];
+  }
+  std::vector<long> members(n_var);
+  std::vector<long> next(start.begin(), start.end() - 1);
+  for(long v=0;v<n_var;v++){
+    members[next[find(v)] ++] = v;
+  }
+
+  n_clusters = 0;
+  n_flipped = 0;
+  for(long root=0;root<n_var;root++){
+    const long n = start[root + 1] - start[root];
+    if(n == 0 || is_frozen[root]) continue;
+    const long * const cluster = &members[start[root]];
+    const double pot_keep = cluster_potential(cluster, n, root);
+    flip(cluster, n);
+    const double pot_flip = cluster_potential(cluster, n, root);
+    const bool is_flipped = erand48(p_rand_seed) * (1.0 + exp(pot_keep - pot_flip)) < 1.0;
+    if(!is_flipped){
+      flip(cluster, n);
+    }
+    if(n > 1){
+      n_clusters ++;
+      if(is_flipped) n_flipped ++;
+    }
+  }
+}
+
+double dd::ClusterSampler::cluster_potential(const long * const members, long n, long root){
+  const InferenceResult & infrs = *p_fg->infrs;
+  double pot = 0.0;
+  for(long k=0;k<n;k++){
+    const Variable & variable = p_fg->variables[members[k]];
+    if(p_fg->unary_bias != NULL){
+      const VariableValue value = infrs.is_packed ?
+        (*infrs.assignments_evid_bits)[variable.id] : infrs.assignments_evid[variable.id];
+      pot += p_fg->unary_bias[2*variable.id + value];
+    }
+    for(long i=variable.n_start_i_factors;i<variable.n_start_i_factors+variable.n_factors;i++){
+      if(bond_weight(i) > 0) continue;
+      // a factor is counted by its first variable in the cluster
+      const CompactFactor & factor = p_fg->compact_factors[i];
+      bool is_first = true;
+      for(long j=factor.n_start_i_vif;j<factor.n_start_i_vif+factor.n_variables;j++){
+        const long vid = p_fg->vifs[j].vid;
+        if(vid == variable.id) break;
+        if(find(vid) == root){
+          is_first = false;
+          break;
+        }
+      }
+      if(!is_first) continue;
+      double tmp = p_fg->template potential<false>(factor);
+      if(p_fg->compact_factors_multiplicities != NULL){
+        tmp *= p_fg->compact_factors_multiplicities[i];
+      }
+      pot += infrs.weight_values[p_fg->compact_factors_weightids[i]] * tmp;
+    }
+  }
+  return pot * p_fg->inverse_temperature;
+}
+
+void dd::ClusterSampler::flip(const long * const members, long n){
+  const InferenceResult & infrs = *p_fg->infrs;
+  for(long k=0;k<n;k++){
+    Variable & variable = p_fg->variables[members[k]];
+    const VariableValue value = infrs.is_packed ?
+      (*infrs.assignments_evid_bits)[variable.id] : infrs.assignments_evid[variable.id];
+    p_fg->update_evid(variable, 1 - value);
+  }
+}
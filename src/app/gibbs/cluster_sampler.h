@@ -0,0 +1,83 @@
+#include <vector>
+#include "dstruct/factor_graph/factor_graph.h"
+
+#ifndef _CLUSTER_SAMPLER_H_
+#define _CLUSTER_SAMPLER_H_
+
+namespace dd{
+
+  /**
+   * Swendsen-Wang style cluster moves for Boolean variables tied by EQUAL
+   * factors with a positive weight (bond factors).
+   *
+   * Each move activates every bond factor whose variables currently agree
+   * with probability 1 - exp(-w), and joins its variables into a cluster.
+   * Given the active bonds, each cluster can only keep its assignment or flip
+   * all of its variables, and the bond factors do not depend on which. So the
+   * clusters are visited one after another, and each one is flipped with its
+   * conditional probability under the remaining factors. Clusters with a
+   * variable that is not sampled (see sample_evidence) are left as they are.
+   *
+   * Only for Boolean-only graphs, and not for --n_chains.
+   */
+  class ClusterSampler {
+  public:
+    FactorGraph * const p_fg;
+    bool sample_evidence;
+    unsigned short p_rand_seed[3];
+
+    // statistics of the last sample()
+    long n_clusters;  // clusters of more than one variable
+    long n_flipped;   // of those, the ones flipped
+
+    ClusterSampler(FactorGraph * _p_fg, bool sample_evidence);
+
+    /**
+     * Performs one cluster move over the evid assignment
+     */
+    void sample();
+
+  private:
+    // union-find forest over the variables
+    std::vector<long> parent;
+
+    /**
+     * Returns the root of the cluster of vid
+     */
+    inline long find(long vid){
+      while(parent[vid] != vid){
+        parent[vid] = parent[parent[vid]];
+        vid = parent[vid];
+      }
+      return vid;
+    }
+
+    /**
+     * Returns the tempered weight of the i-th factor of compact_factors if it
+     * is a bond factor, 0 otherwise
+     */
+    inline double bond_weight(const long & i) const{
+      if(p_fg->compact_factors[i].func_id != FUNC_EQUAL) return 0.0;
+      double w = p_fg->infrs->weight_values[p_fg->compact_factors_weightids[i]];
+      if(p_fg->compact_factors_multiplicities != NULL){
+        w *= p_fg->compact_factors_multiplicities[i];
+      }
+      return w > 0 ? w * p_fg->inverse_temperature : 0.0;
+    }
+
+    /**
+     * Returns the potential of the non-bond factors of the cluster with the
+     * given members and root, each counted once, under the evid assignment
+     */
+    double cluster_potential(const long * const members, long n, long root);
+
+    /**
+     * Flips the evid values of the given variables
+     */
+    void flip(const long * const members, long n);
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,113 @@
+#include "app/gibbs/convergence_monitor.h"
+#include <math.h>
+#include <algorithm>
+
+dd::ConvergenceMonitor::ConvergenceMonitor(double tolerance, double rhat_threshold) :
+  tolerance(tolerance), rhat_threshold(rhat_threshold), max_delta(INFINITY),
+  max_rhat(INFINITY), n_checks(0) {}
+
+bool dd::ConvergenceMonitor::is_enabled() const {
+  return tolerance > 0 || rhat_threshold > 0;
+}
+
+double dd::ConvergenceMonitor::rhat(const double * means, int m, double n) {
+  if (m < 2 || n < 2) return INFINITY;
+  double mean = 0.0;
+  for (int j = 0; j < m; j++) {
+    mean += means[j];
+  }
+  mean /= m;
+  // within-chain variance, from the Bernoulli variance of each chain, and
+  // between-chain variance of the chain means (B/n)
+  double w = 0.0, b_over_n = 0.0;
+  for (int j = 0; j < m; j++) {
+    w += means[j] * (1 - means[j]) * n / (n - 1);
+    b_over_n += (means[j] - mean) * (means[j] - mean);
+  }
+  w /= m;
+  b_over_n /= m - 1;
+  if (w <= 0) {
+    return b_over_n <= 0 ? 1.0 : INFINITY;
+  }
+  return sqrt(((n - 1) / n * w + b_over_n) / w);
+}
+
+bool dd::ConvergenceMonitor::check(const std::vector<FactorGraph> & factorgraphs,
+  bool sample_evidence) {
+  const FactorGraph & fg = factorgraphs[0];
+  // every chain of every replica is one chain for R-hat
+  const int n_chains = fg.infrs->chains == NULL ? 1 : fg.infrs->chains->nchains;
+  const int m = factorgraphs.size() * n_chains;
+  const bool is_first_check = last_marginals.empty();
+  if (is_first_check) {
+    last_marginals.resize(fg.n_var, 0.0);
+  }
+  is_var_converged.assign(fg.n_var, true);
+
+  // at checks 1, 2, 4, 8, ... the older split point is replaced
+  n_checks ++;
+  const bool is_split_check = rhat_threshold > 0 && (n_checks & (n_checks - 1)) == 0;
+  if (is_split_check) {
+    split_sums[0].swap(split_sums[1]);
+    split_counts[0].swap(split_counts[1]);
+    split_sums[1].assign(fg.n_var * m, 0.0);
+    split_counts[1].assign(fg.n_var * m, 0.0);
+  }
+
+  std::vector<double> sums(m), counts(m), halves(2 * m);
+  max_delta = 0.0;
+  max_rhat = 1.0;
+  for (long i = 0; i < fg.n_var; i++) {
+    const Variable & variable = fg.variables[i];
+    if (variable.is_observation || (variable.is_evid && !sample_evidence)) continue;
+
+    double sum = 0.0, nsamples = 0.0;
+    for (size_t j = 0; j < factorgraphs.size(); j++) {
+      const InferenceResult & infrs = *factorgraphs[j].infrs;
+      sum += infrs.agg_means[i];
+      nsamples += infrs.agg_nsamples[i];
+      for (int c = 0; c < n_chains; c++) {
+        sums[j * n_chains + c] = infrs.chains == NULL ? infrs.agg_means[i] : 
+          infrs.chain_means[i * n_chains + c];
+        counts[j * n_chains + c] = infrs.agg_nsamples[i] / n_chains;
+      }
+    }
+    if (nsamples == 0) continue;
+
+    const double marginal = sum / nsamples;
+    const double delta = fabs(marginal - last_marginals[i]);
+    max_delta = std::max(max_delta, delta);
+    last_marginals[i] = marginal;
+    if (tolerance > 0 && (is_first_check || delta >= tolerance)) {
+      is_var_converged[i] = false;
+    }
+
+    if (rhat_threshold > 0 && variable.domain_type == DTYPE_BOOLEAN) {
+      if (is_split_check) {
+        std::copy(sums.begin(), sums.end(), split_sums[1].begin() + i * m);
+        std::copy(counts.begin(), counts.end(), split_counts[1].begin() + i * m);
+      }
+      // the split point closest to half of the samples
+      int s = 1;
+      if (!split_counts[0].empty() && fabs(2 * split_counts[0][i * m] - counts[0]) < 
+        fabs(2 * split_counts[1][i * m] - counts[0])) {
+        s = 0;
+      }
+      double n = INFINITY;
+      for (int j = 0; j < m; j++) {
+        const double n_first = split_counts[s][i * m + j];
+        const double n_second = counts[j] - n_first;
+        halves[2 * j] = n_first > 0 ? split_sums[s][i * m + j] / n_first : 0;
+        halves[2 * j + 1] = n_second > 0 ? (sums[j] - split_sums[s][i * m + j]) / n_second : 0;
+        n = std::min(n, std::min(n_first, n_second));
+      }
+      const double r = rhat(halves.data(), 2 * m, n);
+      max_rhat = std::max(max_rhat, r);
+      if (r >= rhat_threshold) is_var_converged[i] = false;
+    }
+  }
+
+  if (tolerance > 0 && (is_first_check || max_delta >= tolerance)) return false;
+  if (rhat_threshold > 0 && max_rhat >= rhat_threshold) return false;
+  return true;
+}
@@ -0,0 +1,75 @@
+#include <vector>
+#include "dstruct/factor_graph/factor_graph.h"
+
+#ifndef _CONVERGENCE_MONITOR_H_
+#define _CONVERGENCE_MONITOR_H_
+
+namespace dd{
+
+  /**
+   * Decides when inference can stop, from the marginals the replicas of the
+   * factor graph (which are independent chains) have accumulated so far.
+   *
+   * There are two criteria, and all enabled ones must hold:
+   *  - the largest change of the marginal of a query variable since the last
+   *    check is below tolerance;
+   *  - the largest split R-hat (potential scale reduction factor) of the
+   *    Boolean query variables across the replicas, or across all their
+   *    chains with --n_chains, is below rhat_threshold. Each chain is split
+   *    into the samples before and after a split point, so that a chain that
+   *    is still drifting counts as two disagreeing ones. The split points
+   *    are the checks at powers of two, and for each variable the one
+   *    closest to half of its samples is used. Chains that start from the
+   *    same assignment can agree before they mix, so R-hat is only
+   *    meaningful from dispersed starts, see
+   *    InferenceResult::disperse_assignments().
+   * Query variables are the variables sampled during inference.
+   */
+  class ConvergenceMonitor {
+  public:
+    double tolerance;       // 0 to disable
+    double rhat_threshold;  // 0 to disable
+
+    // diagnostics of the last check
+    double max_delta;
+    double max_rhat;
+
+    // marginals of the last check
+    std::vector<double> last_marginals;
+
+    // whether each variable met all enabled criteria in the last check, by
+    // id; variables without samples count as converged
+    std::vector<bool> is_var_converged;
+
+    // number of checks so far
+    long n_checks;
+
+    // sums and counts of the samples of each chain of each variable, at
+    // [vid * m + chain], at the last two checks at powers of two
+    std::vector<double> split_sums[2];
+    std::vector<double> split_counts[2];
+
+    ConvergenceMonitor(double tolerance, double rhat_threshold);
+
+    /**
+     * Returns whether any criterion is enabled
+     */
+    bool is_enabled() const;
+
+    /**
+     * Updates the diagnostics from the given replicas, and returns whether
+     * all enabled criteria hold.
+     */
+    bool check(const std::vector<FactorGraph> & factorgraphs, bool sample_evidence);
+
+    /**
+     * Returns the R-hat of a Boolean variable given the mean of each of the
+     * m chains, each with n samples. For split R-hat, the halves of the
+     * chains are passed as 2m chains.
+     */
+    static double rhat(const double * means, int m, double n);
+  };
+
+}
+
+#endif
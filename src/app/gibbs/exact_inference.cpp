@@ -0,0 +1,79 @@
+#include "app/gibbs/exact_inference.h"
+#include <math.h>
+
+dd::ExactInference::ExactInference(FactorGraph * _p_fg) : p_fg(_p_fg),
+  n_components(0), n_configs(0) {}
+
+void dd::ExactInference::solve(const VariableSchedule & schedule){
+  init_distributions(*p_fg);
+  vids = schedule.exact;
+  n_components = schedule.exact_bounds.empty() ? 0 : schedule.exact_bounds.size() - 1;
+  n_configs = 0;
+  for(long c=0;c<n_components;c++){
+    solve_component(&schedule.exact[schedule.exact_bounds[c]],
+      schedule.exact_bounds[c+1] - schedule.exact_bounds[c]);
+  }
+}
+
+void dd::ExactInference::solve_component(const long * const members, long n){
+  const InferenceResult & infrs = *p_fg->infrs;
+  std::vector<VariableValue> values(n), saved(n);
+  std::vector<int> directions(n, 1);
+
+  // start from all zeros, the log potential is relative to it
+  for(long k=0;k<n;k++){
+    Variable & variable = p_fg->variables[members[k]];
+    saved[k] = infrs.is_packed ? (*infrs.assignments_evid_bits)[variable.id] :
+      infrs.assignments_evid[variable.id];
+    p_fg->update_evid(variable, 0);
+    values[k] = 0;
+  }
+  double log_pot = 0.0;
+  // the sums are scaled by exp(-max_log_pot) to stay finite
+  double max_log_pot = 0.0;
+
+  while(true){
+    if(log_pot > max_log_pot){
+      const double scale = exp(max_log_pot - log_pot);
+      for(long k=0;k<n;k++){
+        for(long j=q_start[members[k]];j<q_start[members[k]+1];j++){
+          q[j] *= scale;
+        }
+      }
+      max_log_pot = log_pot;
+    }
+    const double weight = exp(log_pot - max_log_pot);
+    for(long k=0;k<n;k++){
+      q[q_start[members[k]] + values[k]] += weight;
+    }
+    n_configs ++;
+
+    // move the first variable that can move in its direction, and turn
+    // back the ones before it
+    long k = 0;
+    while(k < n && (values[k] + directions[k] < 0 ||
+      values[k] + directions[k] > p_fg->variables[members[k]].upper_bound)){
+      directions[k] = -directions[k];
+      k ++;
+    }
+    if(k == n) break;
+    Variable & variable = p_fg->variables[members[k]];
+    const VariableValue value = values[k] + directions[k];
+    log_pot += p_fg->template potential<false>(variable, value) -
+      p_fg->template potential<false>(variable, values[k]);
+    p_fg->update_evid(variable, value);
+    values[k] = value;
+  }
+
+  for(long k=0;k<n;k++){
+    Variable & variable = p_fg->variables[members[k]];
+    double sum = 0.0;
+    for(long j=q_start[variable.id];j<q_start[variable.id+1];j++){
+      sum += q[j];
+    }
+    for(long j=q_start[variable.id];j<q_start[variable.id+1];j++){
+      q[j] /= sum;
+    }
+    p_fg->update_evid(variable, saved[k]);
+  }
+}
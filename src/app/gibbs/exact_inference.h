@@ -0,0 +1,47 @@
+#include <vector>
+#include "dstruct/factor_graph/factor_graph.h"
+#include "app/gibbs/variable_schedule.h"
+#include "app/gibbs/variable_distributions.h"
+
+#ifndef _EXACT_INFERENCE_H_
+#define _EXACT_INFERENCE_H_
+
+namespace dd{
+
+  /**
+   * Exact marginals of the small components of a schedule, see
+   * VariableSchedule::split_exact(), which gibbs sampling then skips.
+   *
+   * Each component is solved by enumerating the joint values of its
+   * variables in reflected Gray code order, so that consecutive assignments
+   * differ in one variable and the log potential is updated from that
+   * variable's factors alone. A single variable, e.g. one only connected to
+   * evidence, is its closed-form conditional. vids are the solved
+   * variables and q their marginals.
+   */
+  class ExactInference : public VariableDistributions {
+  public:
+    FactorGraph * const p_fg;
+
+    // statistics of the last solve()
+    long n_components;
+    long n_configs;
+
+    ExactInference(FactorGraph * _p_fg);
+
+    /**
+     * Solves the exact components of schedule, on the evid assignment of
+     * p_fg, which is left as it was
+     */
+    void solve(const VariableSchedule & schedule);
+
+  private:
+    /**
+     * Solves the component with the n given variables
+     */
+    void solve_component(const long * const members, long n);
+  };
+
+}
+
+#endif
@@ -1,14 +1,48 @@
 
 #include "app/gibbs/gibbs_sampling.h"
 #include "app/gibbs/single_node_sampler.h"
+#include "app/gibbs/convergence_monitor.h"
+#include "app/gibbs/cluster_sampler.h"
+#include "app/gibbs/mean_field.h"
+#include "app/gibbs/exact_inference.h"
 #include "common.h"
 #include <unistd.h>
 #include <fstream>
 //#include <sstream>
 #include <memory>
+#include <thread>
+#include <algorithm>
 #include "timer.h"
 //#include <map>
 
+// sets each of the given arrays of n elements to their average
+static void average_arrays(const std::vector<double *> & arrays, long n){
+  if(arrays.size() < 2) return;
+  for(size_t i=1;i<arrays.size();i++){
+    for(long j=0;j<n;j++){
+      arrays[0][j] += arrays[i][j];
+    }
+  }
+  for(long j=0;j<n;j++){
+    arrays[0][j] /= arrays.size();
+  }
+  for(size_t i=1;i<arrays.size();i++){
+    memcpy(arrays[i], arrays[0], sizeof(double)*n);
+  }
+}
+
+// performs a cluster move on a factor graph copy on the given node
+static void cluster_task(dd::ClusterSampler * const sampler, int nodeid){
+  numa_run_on_node(nodeid);
+  sampler->sample();
+}
+
+// computes the log potential of the given variables of a factor graph copy
+static void log_potential_task(dd::FactorGraph * const fg, const std::vector<long> * const vids,
+  double * const log_pot){
+  *log_pot = fg->log_potential(*vids);
+}
+
 dd::GibbsSampling::GibbsSampling(FactorGraph * const _p_fg, 
   CmdParser * const _p_cmd_parser, int n_datacopy, bool sample_evidence,
   int burn_in, bool learn_non_evidence) 
@@ -16,6 +50,7 @@ dd::GibbsSampling::GibbsSampling(FactorGraph * const _p_fg,
     burn_in(burn_in), learn_non_evidence(learn_non_evidence) {
     // the highest node number available
     n_numa_nodes = numa_max_node(); 
+    n_nodes = n_numa_nodes + 1;
 
     // if n_datacopy is valid, use it, otherwise, use numa_max_node
     if (n_datacopy >= 1 && n_datacopy <= n_numa_nodes + 1) {
@@ -25,23 +60,126 @@ dd::GibbsSampling::GibbsSampling(FactorGraph * const _p_fg,
     // max possible threads per NUMA node
     n_thread_per_numa = (sysconf(_SC_NPROCESSORS_CONF))/(n_numa_nodes+1);
 
+    n_temperatures = p_cmd_parser->n_temperatures->getValue();
+    max_temperature = p_cmd_parser->max_temperature->getValue();
+    swap_interval = std::max(1, p_cmd_parser->swap_interval->getValue());
+    if (n_temperatures > 1 && (p_fg->infrs->chains != NULL || p_fg->infrs->scan_uncertainty != NULL)) {
+      std::cout << "[WARNING] --n_temperatures is not supported with --n_chains or --adaptive_scan, ignoring it" << std::endl;
+      n_temperatures = 1;
+    }
+    if (n_temperatures > 1 && max_temperature < 1) {
+      std::cout << "[WARNING] --max_temperature must be at least 1, using 10" << std::endl;
+      max_temperature = 10.0;
+    }
+
+    cluster_interval = p_cmd_parser->cluster_interval->getValue();
+    if (cluster_interval > 0) {
+      bool is_boolean_only = true;
+      for(long i=0;i<p_fg->n_var;i++){
+        if(p_fg->variables[i].domain_type != DTYPE_BOOLEAN){
+          is_boolean_only = false;
+          break;
+        }
+      }
+      if (!is_boolean_only || p_fg->infrs->chains != NULL) {
+        std::cout << "[WARNING] --cluster_interval needs a Boolean-only graph without --n_chains, ignoring it" << std::endl;
+        cluster_interval = 0;
+      }
+    }
+
+    damping = p_cmd_parser->damping->getValue();
+    if (damping < 0 || damping >= 1) {
+      std::cout << "[WARNING] --damping must be in [0, 1), using 0.5" << std::endl;
+      damping = 0.5;
+    }
+    warm_start = p_cmd_parser->mean_field_warm_start->getValue();
+    if (warm_start > 0 && p_fg->infrs->chains != NULL) {
+      std::cout << "[WARNING] --mean_field_warm_start is not supported with --n_chains, ignoring it" << std::endl;
+      warm_start = 0;
+    }
+
+    exact_threshold = p_cmd_parser->exact_threshold->getValue();
+    if (exact_threshold > 0 && p_fg->infrs->chains != NULL) {
+      std::cout << "[WARNING] --exact_threshold is not supported with --n_chains, ignoring it" << std::endl;
+      exact_threshold = 0;
+    }
+
+    inference_tolerance = p_cmd_parser->inference_tolerance->getValue();
+    rhat_threshold = p_cmd_parser->rhat_threshold->getValue();
+    if (rhat_threshold > 0 && n_temperatures > 1) {
+      std::cout << "[WARNING] --rhat_threshold is not supported with --n_temperatures, ignoring it" << std::endl;
+      rhat_threshold = 0;
+    }
+    if (rhat_threshold > 0 && n_numa_nodes == 0 && p_fg->infrs->chains == NULL) {
+      std::cout << "[WARNING] --rhat_threshold needs at least two factor graph copies or --n_chains, ignoring it" << std::endl;
+      rhat_threshold = 0;
+    }
+
+    minibatch_fraction = p_cmd_parser->minibatch_fraction->getValue();
+    minibatch_size = p_cmd_parser->minibatch_size->getValue();
+    if (minibatch_fraction <= 0 || minibatch_fraction > 1) {
+      std::cout << "[WARNING] --minibatch_fraction must be in (0, 1], using 1" << std::endl;
+      minibatch_fraction = 1.0;
+    }
+
+    learn_tolerance = p_cmd_parser->learn_tolerance->getValue();
+    learn_patience = p_cmd_parser->learn_patience->getValue();
+    holdout_fraction = p_cmd_parser->holdout_fraction->getValue();
+    if (holdout_fraction < 0 || holdout_fraction >= 1) {
+      std::cout << "[WARNING] --holdout_fraction must be in [0, 1), ignoring it" << std::endl;
+      holdout_fraction = 0;
+    }
+
+    component_schedule = p_cmd_parser->component_schedule->getValue();
+
+    hub_threshold = p_cmd_parser->hub_threshold->getValue();
+    if (hub_threshold > 0 && component_schedule) {
+      std::cout << "[WARNING] --hub_threshold is not supported with --component_schedule, ignoring it" << std::endl;
+      hub_threshold = 0;
+    }
+    if (hub_threshold > 0 && (p_fg->infrs->chains != NULL || p_fg->infrs->scan_uncertainty != NULL)) {
+      std::cout << "[WARNING] --hub_threshold is not supported with --n_chains or --adaptive_scan, ignoring it" << std::endl;
+      hub_threshold = 0;
+    }
+
     this->factorgraphs.push_back(*p_fg);
 
     // copy factor graphs
     for(int i=1;i<=n_numa_nodes;i++){
+      add_copy();
+    }
 
-      numa_run_on_node(i);
-      numa_set_localalloc();
-
-      std::cout << "CREATE FG ON NODE ..." <<  i << std::endl;
-      dd::FactorGraph fg(p_fg->n_var, p_fg->n_factor, p_fg->n_weight, p_fg->n_edge);
-      
-      fg.copy_from(p_fg);
-
-      this->factorgraphs.push_back(fg);
+    int optimizer;
+    if (!parse_optimizer(p_cmd_parser->optimizer->getValue(), optimizer)) {
+      std::cout << "[ERROR] Unknown --optimizer " << p_cmd_parser->optimizer->getValue() << std::endl;
+      exit(1);
+    }
+    for(int i=0;i<=n_numa_nodes;i++){
+      this->factorgraphs[i].infrs->enable_optimizer(optimizer);
     }
   };
 
+double dd::GibbsSampling::log_swap_acceptance(double beta_cold, double beta_hot,
+  double log_pot_cold, double log_pot_hot){
+  // untempered log potentials of the two assignments
+  const double s_cold = log_pot_cold / beta_cold;
+  const double s_hot = log_pot_hot / beta_hot;
+  return (beta_cold - beta_hot) * (s_hot - s_cold);
+}
+
+void dd::GibbsSampling::add_copy(){
+  const int i = this->factorgraphs.size();
+  numa_run_on_node(i % n_nodes);
+  numa_set_localalloc();
+
+  std::cout << "CREATE FG ON NODE ..." <<  i % n_nodes << std::endl;
+  dd::FactorGraph fg(p_fg->n_var, p_fg->n_factor, p_fg->n_weight, p_fg->n_edge);
+  
+  fg.copy_from(p_fg);
+
+  this->factorgraphs.push_back(fg);
+}
+
 void dd::GibbsSampling::inference(const int & n_epoch, const bool is_quiet){
 
   Timer t_total;
@@ -49,16 +187,126 @@ void dd::GibbsSampling::inference(const int & n_epoch, const bool is_quiet){
   Timer t;
   int nvar = this->factorgraphs[0].n_var;
   int nnode = n_numa_nodes + 1;
+  int n_thread = n_thread_per_numa;
+
+  // with parallel tempering, one copy per temperature, as many on each node
+  // as it takes; the copies learning does not use are made here, and get
+  // the current weights
+  if (n_temperatures > 1) {
+    nnode = n_temperatures;
+    while ((int) this->factorgraphs.size() < nnode) {
+      add_copy();
+    }
+    for(int i=n_numa_nodes+1;i<nnode;i++){
+      memcpy(this->factorgraphs[i].infrs->weight_values, this->factorgraphs[0].infrs->weight_values,
+        sizeof(double)*this->factorgraphs[0].n_weight);
+    }
+    const int copies_per_node = (nnode + n_nodes - 1) / n_nodes;
+    n_thread = std::max(1L, sysconf(_SC_NPROCESSORS_CONF) / n_nodes / copies_per_node);
+
+    // only copy 0 collects samples, the learning copies left out have none
+    for(int i=nnode;i<=n_numa_nodes;i++){
+      InferenceResult & infrs = *this->factorgraphs[i].infrs;
+      memset(infrs.agg_means, 0, sizeof(double)*infrs.nvars);
+      memset(infrs.agg_nsamples, 0, sizeof(double)*infrs.nvars);
+      memset(infrs.multinomial_tallies, 0, sizeof(double)*infrs.ntallies);
+    }
+  }
 
   // single node samplers
   std::vector<SingleNodeSampler> single_node_samplers;
-  for(int i=0;i<=n_numa_nodes;i++){
+  for(int i=0;i<nnode;i++){
+    // with parallel tempering, the hot copies never collect samples
+    const int copy_burn_in = n_temperatures > 1 && i > 0 ? n_epoch : burn_in;
     single_node_samplers.push_back(SingleNodeSampler(&this->factorgraphs[i], 
-      n_thread_per_numa, i, sample_evidence, burn_in));
+      n_thread, i % n_nodes, sample_evidence, copy_burn_in));
   }
 
-  for(int i=0;i<=n_numa_nodes;i++){
+  ConvergenceMonitor monitor(inference_tolerance, rhat_threshold);
+
+  // every copy starts from its own draw of the mean-field marginals
+  if (warm_start > 0) {
+    MeanField mf(&this->factorgraphs[0], sample_evidence, damping, 1e-4);
+    mf.run(warm_start, n_thread, is_quiet);
+    unsigned short warm_seed[3] = {(unsigned short) rand(), (unsigned short) rand(), 
+      (unsigned short) rand()};
+    for(int i=0;i<nnode;i++){
+      mf.sample_assignment(*this->factorgraphs[i].infrs, warm_seed);
+    }
+  }
+
+  // R-hat compares the copies, which would otherwise start from the same
+  // assignment, see FactorGraph::copy_from()
+  if (rhat_threshold > 0 && warm_start == 0) {
+    for(int i=1;i<nnode;i++){
+      this->factorgraphs[i].infrs->disperse_assignments(this->factorgraphs[i].variables, 
+        sample_evidence);
+    }
+  }
+
+  for(int i=0;i<nnode;i++){
     single_node_samplers[i].clear_variabletally();
+    this->factorgraphs[i].infrs->reset_adaptive_scan();
+    this->factorgraphs[i].infrs->pack_assignments();
+    this->factorgraphs[i].infrs->reset_chains(this->factorgraphs[i].variables, sample_evidence);
+    this->factorgraphs[i].use_inference_view(true);
+    this->factorgraphs[i].update_unary_bias();
+  }
+
+  // only the sampled variables, the replicas share the same schedule
+  VariableSchedule schedule;
+  schedule.build_inference(this->factorgraphs[0], sample_evidence, n_thread);
+  // the small components are not sampled, but solved once
+  ExactInference exact(&this->factorgraphs[0]);
+  if (exact_threshold > 0) {
+    Timer t_exact;
+    schedule.split_exact(this->factorgraphs[0], exact_threshold, 1L << 16, n_thread);
+    exact.solve(schedule);
+    if (!is_quiet) {
+      std::cout << "EXACT COMPONENTS: #" << exact.n_components << " WITH #"
+        << schedule.exact.size() << " VARIABLES, " << exact.n_configs << " ASSIGNMENTS IN "
+        << t_exact.elapsed() << " sec." << std::endl;
+    }
+  }
+  if (component_schedule) {
+    schedule.order_by_component(this->factorgraphs[0], n_thread);
+    if (!is_quiet) {
+      std::cout << "COMPONENTS: #" << schedule.component_bounds.size() - 1 << std::endl;
+    }
+  }
+  if (hub_threshold > 0) {
+    schedule.split_hubs(this->factorgraphs[0], hub_threshold, n_thread);
+    if (!is_quiet) {
+      std::cout << "HUB VARIABLES: #" << schedule.hubs.size() << std::endl;
+    }
+  }
+  for(int i=0;i<nnode;i++){
+    single_node_samplers[i].schedule = &schedule;
+    this->factorgraphs[i].infrs->share_bit_words(!schedule.is_word_aligned());
+  }
+
+  std::vector<ClusterSampler> cluster_samplers;
+  if (cluster_interval > 0) {
+    for(int i=0;i<nnode;i++){
+      cluster_samplers.push_back(ClusterSampler(&this->factorgraphs[i], sample_evidence));
+    }
+  }
+
+  // temperature ladder for parallel tempering, geometric from 1
+  std::vector<long> sampled;
+  unsigned short swap_seed[3] = {(unsigned short) rand(), (unsigned short) rand(), 
+    (unsigned short) rand()};
+  long n_swaps_proposed = 0, n_swaps_accepted = 0;
+  if (n_temperatures > 1) {
+    sampled = schedule.vids;
+    sampled.insert(sampled.end(), schedule.hubs.begin(), schedule.hubs.end());
+    if (!is_quiet) std::cout << "TEMPERATURES:";
+    for(int i=0;i<nnode;i++){
+      this->factorgraphs[i].inverse_temperature = 
+        pow(max_temperature, -(double) i / (nnode - 1));
+      if (!is_quiet) std::cout << " " << 1.0 / this->factorgraphs[i].inverse_temperature;
+    }
+    if (!is_quiet) std::cout << std::endl;
   }
 
   // inference epochs
@@ -74,6 +322,7 @@ void dd::GibbsSampling::inference(const int & n_epoch, const bool is_quiet){
 
     // sample
     for(int i=0;i<nnode;i++){
+      this->factorgraphs[i].infrs->n_visits = 0;
       single_node_samplers[i].sample(i_epoch);
     }
 
@@ -82,11 +331,135 @@ void dd::GibbsSampling::inference(const int & n_epoch, const bool is_quiet){
       single_node_samplers[i].wait();
     }
 
+    // then the hub variables, each with all threads of its node
+    if (!schedule.hubs.empty()) {
+      for(int i=0;i<nnode;i++){
+        single_node_samplers[i].sample_hubs(i_epoch);
+      }
+      for(int i=0;i<nnode;i++){
+        single_node_samplers[i].wait();
+      }
+    }
+
+    // cluster moves, one thread per copy
+    const bool is_cluster_epoch = cluster_interval > 0 && (i_epoch + 1) % cluster_interval == 0;
+    if (is_cluster_epoch) {
+      std::vector<std::thread> threads;
+      for(int i=0;i<nnode;i++){
+        threads.push_back(std::thread(cluster_task, &cluster_samplers[i], i % n_nodes));
+      }
+      for(int i=0;i<nnode;i++){
+        threads[i].join();
+      }
+    }
+
+    // propose to exchange the assignments of neighbouring temperatures,
+    // alternating between the even and the odd pairs
+    if (n_temperatures > 1 && (i_epoch + 1) % swap_interval == 0) {
+      std::vector<double> log_pots(nnode);
+      std::vector<std::thread> threads;
+      for(int i=0;i<nnode;i++){
+        threads.push_back(std::thread(log_potential_task, &this->factorgraphs[i], 
+          &sampled, &log_pots[i]));
+      }
+      for(int i=0;i<nnode;i++){
+        threads[i].join();
+      }
+      for(int i=(i_epoch / swap_interval) % 2;i+1<nnode;i+=2){
+        FactorGraph & cold = this->factorgraphs[i];
+        FactorGraph & hot = this->factorgraphs[i+1];
+        const double log_accept = log_swap_acceptance(cold.inverse_temperature, 
+          hot.inverse_temperature, log_pots[i], log_pots[i+1]);
+        n_swaps_proposed ++;
+        if (log_accept >= 0 || erand48(swap_seed) < exp(log_accept)) {
+          cold.infrs->swap_assignments(*hot.infrs);
+          n_swaps_accepted ++;
+        }
+      }
+    }
+
     double elapsed = t.elapsed();
     if (!is_quiet) {
       std::cout << ""  << elapsed << " sec." ;
-      std::cout << ","  << (nvar*nnode)/elapsed << " vars/sec" << std::endl;
+      std::cout << ","  << (nvar*nnode)/elapsed << " vars/sec";
+      if (this->factorgraphs[0].infrs->scan_uncertainty != NULL) {
+        long n_visits = 0;
+        for(int i=0;i<nnode;i++){
+          n_visits += this->factorgraphs[i].infrs->n_visits;
+        }
+        std::cout << "," << n_visits << " vars visited";
+      }
+      if (is_cluster_epoch) {
+        std::cout << "," << cluster_samplers[0].n_flipped << "/" 
+          << cluster_samplers[0].n_clusters << " clusters flipped";
+      }
+      std::cout << std::endl;
+    }
+
+    // stop once converged, burn-in epochs do not accumulate marginals
+    if (monitor.is_enabled() && i_epoch >= burn_in) {
+      bool is_converged = monitor.check(this->factorgraphs, sample_evidence);
+      if (!is_quiet) {
+        std::cout << "   MAX MARGINAL DELTA=" << monitor.max_delta;
+        if (rhat_threshold > 0) std::cout << ",MAX R-HAT=" << monitor.max_rhat;
+        std::cout << std::endl;
+      }
+      if (is_converged) {
+        std::cout << "INFERENCE CONVERGED AT EPOCH " << (i_epoch+1) * nnode 
+          << " OF " << n_epoch * nnode << std::endl;
+        break;
+      }
+
+      // components are independent, the converged ones need no more samples
+      if (component_schedule) {
+        const std::vector<long> & bounds = schedule.component_bounds;
+        std::vector<bool> is_removed(bounds.size() - 1, true);
+        for(size_t c=0;c+1<bounds.size();c++){
+          for(long k=bounds[c];k<bounds[c+1] && is_removed[c];k++){
+            is_removed[c] = monitor.is_var_converged[schedule.vids[k]];
+          }
+        }
+        const long n_removed = schedule.remove_components(this->factorgraphs[0], 
+          is_removed, n_thread);
+        if (!is_quiet && n_removed > 0) {
+          std::cout << "   COMPONENTS CONVERGED: #" << n_removed << ", #" 
+            << schedule.component_bounds.size() - 1 << " LEFT" << std::endl;
+        }
+        for(int i=0;i<nnode;i++){
+          this->factorgraphs[i].infrs->share_bit_words(!schedule.is_word_aligned());
+        }
+      }
+    }
+  }
+
+  // the exact marginals are one sample of copy 0
+  if (exact_threshold > 0) {
+    for(int i=0;i<nnode;i++){
+      for(size_t k=0;k<schedule.exact.size();k++){
+        const Variable & variable = this->factorgraphs[i].variables[schedule.exact[k]];
+        InferenceResult & infrs = *this->factorgraphs[i].infrs;
+        infrs.agg_means[variable.id] = 0;
+        infrs.agg_nsamples[variable.id] = 0;
+        if (variable.domain_type == DTYPE_MULTINOMIAL) {
+          for(long x=0;x<=variable.upper_bound;x++){
+            infrs.multinomial_tallies[variable.n_start_i_tally + x] = 0;
+          }
+        }
+      }
     }
+    exact.write_marginals(this->factorgraphs[0], *this->factorgraphs[0].infrs);
+  }
+
+  for(int i=0;i<nnode;i++){
+    this->factorgraphs[i].infrs->unpack_assignments();
+    this->factorgraphs[i].infrs->save_chains();
+    this->factorgraphs[i].use_inference_view(false);
+    this->factorgraphs[i].inverse_temperature = 1.0;
+  }
+
+  if (n_temperatures > 1) {
+    std::cout << "REPLICA EXCHANGE: " << n_swaps_accepted << " OF " << n_swaps_proposed 
+      << " SWAPS ACCEPTED" << std::endl;
   }
 
   double elapsed = t_total.elapsed();
@@ -158,12 +531,45 @@ void dd::GibbsSampling::learn(const int & n_epoch, const int & n_sample_per_epoc
   std::vector<SingleNodeSampler> single_node_samplers;
   for(int i=0;i<=n_numa_nodes;i++){
     single_node_samplers.push_back(SingleNodeSampler(&this->factorgraphs[i], 
-      n_thread_per_numa, i, false, 0, learn_non_evidence));
+      n_thread_per_numa, i % n_nodes, false, 0, learn_non_evidence));
+    this->factorgraphs[i].infrs->pack_assignments();
+    this->factorgraphs[i].update_unary_bias();
+  }
+
+  // only the variables that contribute gradients
+  VariableSchedule schedule;
+  schedule.build_learning(this->factorgraphs[0], learn_non_evidence, n_thread_per_numa);
+  const std::vector<long> holdout = schedule.split_holdout(this->factorgraphs[0], 
+    holdout_fraction, n_thread_per_numa);
+
+  double fraction = minibatch_fraction;
+  if(minibatch_size > 0 && schedule.vids.size() > 0){
+    fraction = std::min(1.0, (double) minibatch_size / schedule.vids.size());
+  }
+  long n_batch = 0;
+  for(int i=0;i<n_thread_per_numa;i++){
+    n_batch += schedule.batch_size(i, fraction);
+  }
+
+  // minibatches are drawn by shuffling the schedule in place, so each
+  // replica gets its own copy
+  std::vector<VariableSchedule> schedules(fraction < 1.0 ? nnode : 1, schedule);
+  // minibatches shuffle within a worker's range, which keeps word owners
+  for(int i=0;i<=n_numa_nodes;i++){
+    single_node_samplers[i].schedule = &schedules[fraction < 1.0 ? i : 0];
+    single_node_samplers[i].minibatch_fraction = fraction;
+    this->factorgraphs[i].infrs->share_bit_words(!schedule.is_word_aligned());
   }
 
   std::unique_ptr<double[]> ori_weights(new double[nweight]);
   memcpy(ori_weights.get(), this->factorgraphs[0].infrs->weight_values, sizeof(double)*nweight);
 
+  // early stopping, see learn_tolerance
+  std::unique_ptr<double[]> best_weights(holdout.empty() ? NULL : new double[nweight]);
+  double best_loss = INFINITY;
+  int best_epoch = -1;
+  int n_stalled = 0;
+
   // learning epochs
   for(int i_epoch=0;i_epoch<n_epoch;i_epoch++){
 
@@ -226,6 +632,28 @@ void dd::GibbsSampling::learn(const int & n_epoch, const int & n_sample_per_epoc
       }
     }    
 
+    // likewise average the optimizer state
+    if(cfg.infrs->weight_v != NULL){
+      std::vector<double *> ms, vs, b1s, b2s;
+      for(int i=0;i<=n_numa_nodes;i++){
+        ms.push_back(this->factorgraphs[i].infrs->weight_m);
+        vs.push_back(this->factorgraphs[i].infrs->weight_v);
+        b1s.push_back(this->factorgraphs[i].infrs->weight_beta1_t);
+        b2s.push_back(this->factorgraphs[i].infrs->weight_beta2_t);
+      }
+      average_arrays(vs, nweight);
+      if(cfg.infrs->weight_m != NULL){
+        average_arrays(ms, nweight);
+        average_arrays(b1s, nweight);
+        average_arrays(b2s, nweight);
+      }
+    }
+
+    // refresh the folded unary factors with the new weights
+    for(int i=0;i<=n_numa_nodes;i++){
+      this->factorgraphs[i].update_unary_bias();
+    }
+
     // calculate the norms of the difference of weights from the current epoch
     // and last epoch
     double lmax = -1000000;
@@ -243,11 +671,47 @@ void dd::GibbsSampling::learn(const int & n_epoch, const int & n_sample_per_epoc
     double elapsed = t.elapsed();
     if (!is_quiet) {
       std::cout << "" << elapsed << " sec.";
-      std::cout << ","  << (nvar*nnode)/elapsed << " vars/sec." << ",stepsize=" << current_stepsize << ",lmax=" << lmax << ",l2=" << sqrt(l2)/current_stepsize << std::endl;
+      if (fraction < 1.0) {
+        std::cout << ",minibatch=" << n_batch << " vars," << (n_batch*nnode)/elapsed << " vars/sec.";
+      } else {
+        std::cout << ","  << (nvar*nnode)/elapsed << " vars/sec.";
+      }
+      std::cout << ",stepsize=" << current_stepsize << ",lmax=" << lmax << ",l2=" << sqrt(l2)/current_stepsize;
     }
 
+    bool is_stalled = learn_tolerance > 0 && lmax < learn_tolerance;
+    if (!holdout.empty()) {
+      double loss = cfg.neg_ps_loglikelihood(holdout) / holdout.size();
+      if (!is_quiet) std::cout << ",holdout_loss=" << loss;
+      is_stalled = loss > best_loss - learn_tolerance;
+      if (loss < best_loss) {
+        best_loss = loss;
+        best_epoch = i_epoch;
+        memcpy(best_weights.get(), cfg.infrs->weight_values, sizeof(double)*nweight);
+      }
+    }
+    if (!is_quiet) std::cout << std::endl;
+
     current_stepsize = current_stepsize * decay;
 
+    n_stalled = is_stalled ? n_stalled + 1 : 0;
+    if ((learn_tolerance > 0 || !holdout.empty()) && n_stalled >= learn_patience) {
+      std::cout << "LEARNING CONVERGED AT EPOCH " << (i_epoch+1) * nnode << std::endl;
+      break;
+    }
+  }
+
+  // go back to the weights with the lowest held-out loss
+  if (best_epoch >= 0) {
+    std::cout << "BEST HOLDOUT LOSS " << best_loss << " AT EPOCH " << (best_epoch+1) * nnode << std::endl;
+    for(int i=0;i<=n_numa_nodes;i++){
+      memcpy(this->factorgraphs[i].infrs->weight_values, best_weights.get(), sizeof(double)*nweight);
+      this->factorgraphs[i].update_unary_bias();
+    }
+  }
+
+  for(int i=0;i<=n_numa_nodes;i++){
+    this->factorgraphs[i].infrs->unpack_assignments();
   }
 
   double elapsed = t_total.elapsed();
@@ -284,13 +748,28 @@ void dd::GibbsSampling::dump_weights(const bool is_quiet){
   fout_text.close();
 }
 
+void dd::GibbsSampling::mean_field(const int & n_iter, const bool is_quiet){
+  MeanField mf(&this->factorgraphs[0], sample_evidence, damping,
+    inference_tolerance > 0 ? inference_tolerance : 1e-4);
+  mf.run(n_iter, n_thread_per_numa * n_nodes, is_quiet);
+
+  // the marginals are one sample of copy 0
+  for(int i=0;i<=n_numa_nodes;i++){
+    InferenceResult & infrs = *this->factorgraphs[i].infrs;
+    memset(infrs.agg_means, 0, sizeof(double)*infrs.nvars);
+    memset(infrs.agg_nsamples, 0, sizeof(double)*infrs.nvars);
+    memset(infrs.multinomial_tallies, 0, sizeof(double)*infrs.ntallies);
+  }
+  mf.write_marginals(this->factorgraphs[0], *this->factorgraphs[0].infrs);
+}
+
 void dd::GibbsSampling::aggregate_results_and_dump(const bool is_quiet){
 
   // sum of variable assignments
   std::unique_ptr<double[]> agg_means(new double[factorgraphs[0].n_var]);
   // number of samples
   std::unique_ptr<double[]> agg_nsamples(new double[factorgraphs[0].n_var]);
-  std::unique_ptr<int[]> multinomial_tallies(new int[factorgraphs[0].infrs->ntallies]);
+  std::unique_ptr<double[]> multinomial_tallies(new double[factorgraphs[0].infrs->ntallies]);
 
   for(long i=0;i<factorgraphs[0].n_var;i++){
     agg_means[i] = 0;
@@ -25,8 +25,13 @@ namespace dd{
 
     // the highest node number available
     // actually, number of NUMA nodes = n_numa_nodes + 1
+    // Copy i runs on node i % n_nodes. With --n_temperatures, inference
+    // uses n_temperatures copies instead, see inference().
     int n_numa_nodes;
 
+    // number of NUMA nodes of the machine
+    int n_nodes;
+
     // number of threads per NUMA node
     int n_thread_per_numa;
 
@@ -42,6 +47,58 @@ namespace dd{
     // whether sample non-evidence during learning
     bool learn_non_evidence;
 
+    // inference stops early once the marginals change by less than
+    // inference_tolerance per epoch, and/or the R-hat across replicas is
+    // below rhat_threshold; 0 disables each. See ConvergenceMonitor.
+    double inference_tolerance;
+    double rhat_threshold;
+
+    // each learning epoch samples a random minibatch_fraction of the
+    // evidence, or minibatch_size evidence variables if it is positive
+    double minibatch_fraction;
+    long minibatch_size;
+
+    // learning stops once lmax stays below learn_tolerance for learn_patience
+    // epochs. With a holdout_fraction of the evidence held out, it instead
+    // stops once their negative pseudo-loglikelihood has not improved by
+    // learn_tolerance for learn_patience epochs, and keeps the best weights.
+    double learn_tolerance;
+    int learn_patience;
+    double holdout_fraction;
+
+    // in inference, Boolean variables with at least hub_threshold factors are
+    // sampled after each sweep, with the potential sums split among all
+    // threads of the node; 0 disables it. See SingleNodeSampler::sample_hubs().
+    long hub_threshold;
+
+    // parallel tempering in inference: copy i samples at temperature
+    // max_temperature^(i/(n_temperatures-1)), and neighbouring copies
+    // propose to exchange their assignments every swap_interval epochs.
+    // Only copy 0, at temperature 1, collects samples. 1 disables it.
+    int n_temperatures;
+    double max_temperature;
+    int swap_interval;
+
+    // in inference, every cluster_interval sweeps are followed by a cluster
+    // move on each copy, see ClusterSampler; 0 disables it
+    int cluster_interval;
+
+    // damping of mean-field inference, see MeanField; inference starts
+    // every copy from a draw of warm_start mean-field iterations if positive
+    double damping;
+    int warm_start;
+
+    // in inference, the connected components of at most exact_threshold
+    // sampled variables (and 2^16 joint values) are solved exactly instead
+    // of sampled, see ExactInference; 0 disables it
+    long exact_threshold;
+
+    // in inference, schedule the sampled variables by connected component,
+    // and stop sampling each component once all of its variables meet the
+    // enabled ConvergenceMonitor criteria. See
+    // VariableSchedule::order_by_component().
+    bool component_schedule;
+
     /**
      * Constructs GibbsSampling class with given factor graph, command line parser,
      * and number of data copies. Allocate factor graph to NUMA nodes.
@@ -74,6 +131,13 @@ namespace dd{
      */
     void inference(const int & n_epoch, const bool is_quiet);
 
+    /**
+     * Approximates the marginals by at most n_iter iterations of mean-field
+     * instead, see MeanField. aggregate_results_and_dump() then dumps them.
+     * is_quiet whether to compress information display
+     */
+    void mean_field(const int & n_iter, const bool is_quiet);
+
     /**
      * Aggregates results from different NUMA nodes
      * Dumps the inference result for variables
@@ -87,6 +151,21 @@ namespace dd{
      */
     void dump_weights(const bool is_quiet);
 
+    /**
+     * Returns the log of the probability to accept exchanging the
+     * assignments of two copies at inverse temperatures beta_cold and
+     * beta_hot, given the tempered log potentials of their assignments, see
+     * FactorGraph::log_potential(); at least 0 means always
+     */
+    static double log_swap_acceptance(double beta_cold, double beta_hot,
+      double log_pot_cold, double log_pot_hot);
+
+    /**
+     * Appends a copy of *p_fg to factorgraphs, allocated on the node it
+     * runs on
+     */
+    void add_copy();
+
   };
 }
 
@@ -0,0 +1,193 @@
+#include "app/gibbs/mean_field.h"
+#include "app/gibbs/variable_schedule.h"
+#include "timer.h"
+#include <stdlib.h>
+#include <math.h>
+#include <iomanip>
+#include <thread>
+#include <algorithm>
+
+// updates the given range of the sampled variables with its own scratch
+// assignment and seed
+static void mean_field_task(dd::MeanField * const mf, long begin, long end){
+  std::vector<dd::VariableValue> values(mf->p_fg->infrs->assignments_evid,
+    mf->p_fg->infrs->assignments_evid + mf->p_fg->n_var);
+  unsigned short p_rand_seed[3] = {(unsigned short) begin, (unsigned short) end, 17};
+  mf->update(begin, end, values.data(), p_rand_seed);
+}
+
+dd::MeanField::MeanField(FactorGraph * _p_fg, bool sample_evidence, double damping,
+  double tolerance) : p_fg(_p_fg), sample_evidence(sample_evidence), damping(damping),
+  tolerance(tolerance), max_configs(256), n_mc_samples(64), n_iterations(0), max_change(0) {}
+
+void dd::MeanField::run(int max_iter, int n_thread, const bool is_quiet){
+  Timer t_total;
+  FactorGraph & fg = *p_fg;
+  fg.use_inference_view(true);
+  fg.update_unary_bias();
+
+  VariableSchedule schedule;
+  schedule.build_inference(fg, sample_evidence, n_thread);
+  vids = schedule.vids;
+
+  // uniform for the sampled variables, the current value for the others
+  init_distributions(fg);
+  is_fixed.assign(fg.n_var, true);
+  for(long i=0;i<fg.n_var;i++){
+    q[q_start[i] + fg.infrs->assignments_evid[i]] = 1.0;
+  }
+  for(size_t k=0;k<vids.size();k++){
+    const long vid = vids[k];
+    is_fixed[vid] = false;
+    const long card = q_start[vid+1] - q_start[vid];
+    for(long j=0;j<card;j++){
+      q[q_start[vid] + j] = 1.0 / card;
+    }
+  }
+  q_new = q;
+
+  for(n_iterations=0;n_iterations<max_iter;){
+    std::vector<std::thread> threads;
+    for(int i=0;i<n_thread;i++){
+      threads.push_back(std::thread(mean_field_task, this, schedule.bounds[i],
+        schedule.bounds[i+1]));
+    }
+    for(int i=0;i<n_thread;i++){
+      threads[i].join();
+    }
+
+    max_change = 0;
+    for(size_t k=0;k<vids.size();k++){
+      for(long j=q_start[vids[k]];j<q_start[vids[k]+1];j++){
+        const double next = damping * q[j] + (1 - damping) * q_new[j];
+        max_change = std::max(max_change, fabs(next - q[j]));
+        q[j] = next;
+      }
+    }
+    n_iterations ++;
+
+    if (!is_quiet) {
+      std::cout << std::setprecision(4) << "MEAN FIELD ITERATION " << n_iterations
+        << ",MAX CHANGE=" << max_change << std::endl;
+    }
+    if (max_change < tolerance) break;
+  }
+
+  fg.use_inference_view(false);
+  std::cout << "MEAN FIELD " << (max_change < tolerance ? "CONVERGED" : "STOPPED")
+    << " AFTER " << n_iterations << " ITERATIONS" << std::endl;
+  std::cout << "TOTAL MEAN FIELD TIME: " << t_total.elapsed() << " sec." << std::endl;
+}
+
+void dd::MeanField::update(long begin, long end, VariableValue * const values,
+  unsigned short * const p_rand_seed){
+  std::vector<double> pot;
+  std::vector<long> others;
+  for(long k=begin;k<end;k++){
+    const Variable & variable = p_fg->variables[vids[k]];
+    const long card = variable.upper_bound + 1;
+    pot.assign(card, 0.0);
+    if(variable.domain_type == DTYPE_BOOLEAN && p_fg->unary_bias != NULL){
+      pot[0] = p_fg->unary_bias[2*variable.id];
+      pot[1] = p_fg->unary_bias[2*variable.id + 1];
+    }
+    for(long i=variable.n_start_i_factors;i<variable.n_start_i_factors+variable.n_factors;i++){
+      expected_potential(variable, i, pot.data(), values, others, p_rand_seed);
+    }
+    double max_pot = pot[0];
+    for(long x=1;x<card;x++){
+      max_pot = std::max(max_pot, pot[x]);
+    }
+    double sum = 0;
+    for(long x=0;x<card;x++){
+      pot[x] = exp(pot[x] - max_pot);
+      sum += pot[x];
+    }
+    for(long x=0;x<card;x++){
+      q_new[q_start[variable.id] + x] = pot[x] / sum;
+    }
+  }
+}
+
+void dd::MeanField::expected_potential(const Variable & variable, long i,
+  double * const pot, VariableValue * const values, std::vector<long> & others,
+  unsigned short * const p_rand_seed){
+  const CompactFactor & factor = p_fg->compact_factors[i];
+  const double multiplicity = p_fg->compact_factors_multiplicities == NULL ? 1.0 :
+    p_fg->compact_factors_multiplicities[i];
+  const long card = variable.upper_bound + 1;
+
+  // the other sampled variables of the factor, and their joint values
+  others.clear();
+  long n_configs = 1;
+  for(long j=factor.n_start_i_vif;j<factor.n_start_i_vif+factor.n_variables;j++){
+    const long vid = p_fg->vifs[j].vid;
+    if(vid == variable.id || is_fixed[vid] ||
+      std::find(others.begin(), others.end(), vid) != others.end()) continue;
+    others.push_back(vid);
+    n_configs = std::min(n_configs * (q_start[vid+1] - q_start[vid]), max_configs + 1);
+  }
+  const int n_others = others.size();
+  const bool is_exact = n_configs <= max_configs;
+
+  // adds prob times the weighted potential of the current values
+  auto accumulate = [&](double prob){
+    for(long x=0;x<card;x++){
+      const double f = factor.potential(p_fg->vifs, values, variable.id, x);
+      if(f == 0) continue;
+      const long wid = variable.domain_type == DTYPE_MULTINOMIAL ?
+        p_fg->get_multinomial_weight_id(values, factor, variable.id, x) :
+        p_fg->compact_factors_weightids[i];
+      pot[x] += prob * multiplicity * p_fg->infrs->weight_values[wid] * f;
+    }
+  };
+
+  if(is_exact){
+    // all joint values, as a mixed-radix counter starting at all zeros
+    for(int o=0;o<n_others;o++){
+      values[others[o]] = 0;
+    }
+    for(long c=0;c<n_configs;c++){
+      double prob = 1.0;
+      for(int o=0;o<n_others;o++){
+        prob *= q[q_start[others[o]] + values[others[o]]];
+      }
+      if(prob > 0) accumulate(prob);
+      for(int o=0;o<n_others;o++){
+        if(values[others[o]] < q_start[others[o]+1] - q_start[others[o]] - 1){
+          values[others[o]] ++;
+          break;
+        }
+        values[others[o]] = 0;
+      }
+    }
+  }else{
+    for(int s=0;s<n_mc_samples;s++){
+      for(int o=0;o<n_others;o++){
+        const long vid = others[o];
+        double r = erand48(p_rand_seed);
+        long x = q_start[vid];
+        while(x < q_start[vid+1] - 1 && r >= q[x]){
+          r -= q[x];
+          x ++;
+        }
+        values[vid] = x - q_start[vid];
+      }
+      accumulate(1.0 / n_mc_samples);
+    }
+  }
+}
+
+void dd::MeanField::sample_assignment(InferenceResult & infrs,
+  unsigned short * const p_rand_seed) const{
+  for(size_t k=0;k<vids.size();k++){
+    const long vid = vids[k];
+    double r = erand48(p_rand_seed);
+    long x = q_start[vid];
+    while(x < q_start[vid+1] - 1 && r >= q[x]){
+      r -= q[x];
+      x ++;
+    }
+    infrs.assignments_evid[vid] = x - q_start[vid];
+  }
+}
@@ -0,0 +1,79 @@
+#include <vector>
+#include "dstruct/factor_graph/factor_graph.h"
+#include "app/gibbs/variable_distributions.h"
+
+#ifndef _MEAN_FIELD_H_
+#define _MEAN_FIELD_H_
+
+namespace dd{
+
+  /**
+   * Damped mean-field inference, a fast deterministic approximation of the
+   * marginals gibbs sampling estimates.
+   *
+   * q holds a distribution over the values of each variable. Every
+   * iteration sets, for all sampled variables at once, q(v = x) proportional
+   * to exp of the expected weighted potential of v's factors with v = x and
+   * the other variables drawn from q. The expectation is exact when the
+   * other sampled variables of a factor have at most max_configs joint
+   * values, and estimated from n_mc_samples draws of q otherwise, so any
+   * factor function works. The new distribution is then mixed with the old
+   * one, q = damping * q + (1 - damping) * q_new, which keeps the parallel
+   * updates from oscillating. Variables that are not sampled (see
+   * sample_evidence) keep their value. vids are the sampled variables, see
+   * VariableSchedule::build_inference().
+   */
+  class MeanField : public VariableDistributions {
+  public:
+    FactorGraph * const p_fg;
+    bool sample_evidence;
+    double damping;
+
+    // iterations stop once no probability changes by more than this
+    double tolerance;
+
+    long max_configs;
+    int n_mc_samples;
+
+    // statistics of the last run()
+    int n_iterations;
+    double max_change;
+
+    MeanField(FactorGraph * _p_fg, bool sample_evidence, double damping, double tolerance);
+
+    /**
+     * Runs at most max_iter iterations from uniform distributions, on
+     * n_thread threads. Uses the inference view if the graph has one.
+     */
+    void run(int max_iter, int n_thread, const bool is_quiet);
+
+    /**
+     * Sets the evid assignment of the sampled variables of infrs to a draw
+     * from q
+     */
+    void sample_assignment(InferenceResult & infrs, unsigned short * const p_rand_seed) const;
+
+    /**
+     * Computes q_new for vids[begin] to vids[end-1], reading q and writing
+     * the scratch assignment values, a copy of the evid assignment
+     */
+    void update(long begin, long end, VariableValue * const values,
+      unsigned short * const p_rand_seed);
+
+  private:
+    std::vector<double> q_new;
+    std::vector<bool> is_fixed;
+
+    /**
+     * Adds to pot[x] the expected weighted potential of the i-th factor of
+     * compact_factors with variable set to x, for all values x. others is
+     * scratch space.
+     */
+    void expected_potential(const Variable & variable, long i, double * const pot,
+      VariableValue * const values, std::vector<long> & others,
+      unsigned short * const p_rand_seed);
+  };
+
+}
+
+#endif
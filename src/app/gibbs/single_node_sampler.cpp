@@ -1,32 +1,122 @@
 
 #include "app/gibbs/single_node_sampler.h"
+#include <mutex>
+#include <condition_variable>
 
 namespace dd{
 
   void gibbs_single_thread_task(FactorGraph * const _p_fg, int i_worker, 
-    int n_worker, bool _sample_evidence, bool burn_in){
+    int n_worker, bool _sample_evidence, bool burn_in, VariableSchedule * schedule){
     SingleThreadSampler sampler = SingleThreadSampler(_p_fg, _sample_evidence, burn_in, false);
-    sampler.sample(i_worker,n_worker);
+    if(schedule != NULL){
+      sampler.sample(*schedule, i_worker);
+    }else{
+      sampler.sample(i_worker,n_worker);
+    }
+  }
+
+  void hub_potential_task(FactorGraph * const _p_fg, const Variable * const variable,
+    long begin, long end, double * const pot_neg, double * const pot_pos){
+    *pot_neg = _p_fg->template potential<false>(*variable, 0, begin, end);
+    *pot_pos = _p_fg->template potential<false>(*variable, 1, begin, end);
+  }
+
+  /**
+   * Reusable barrier, so that the threads summing the hub potentials are
+   * started once per epoch and handed one hub after another
+   */
+  class HubBarrier {
+  public:
+    HubBarrier(int n) : n(n), n_waiting(0), generation(0) {}
+
+    // blocks until all n threads have called wait()
+    void wait(){
+      std::unique_lock<std::mutex> lock(mutex);
+      const long current = generation;
+      if(++n_waiting == n){
+        n_waiting = 0;
+        generation ++;
+        released.notify_all();
+      }else{
+        released.wait(lock, [&]{ return generation != current; });
+      }
+    }
+
+  private:
+    const int n;
+    int n_waiting;
+    long generation;
+    std::mutex mutex;
+    std::condition_variable released;
+  };
+
+  // sums slice i of n_worker of the factors of each hub in turn, waiting
+  // after each for the sum and again for the hub to be sampled
+  void hub_slice_task(FactorGraph * const _p_fg, const std::vector<long> * hubs,
+    int i, int n_worker, double * const pots, HubBarrier * barrier){
+    for(size_t k=0;k<hubs->size();k++){
+      const Variable & variable = _p_fg->variables[(*hubs)[k]];
+      const long n = variable.n_factors;
+      hub_potential_task(_p_fg, &variable, n * i / n_worker, n * (i+1) / n_worker,
+        &pots[2*i], &pots[2*i+1]);
+      barrier->wait();
+      barrier->wait();
+    }
+  }
+
+  void gibbs_hub_task(FactorGraph * const _p_fg, int n_worker, bool _sample_evidence,
+    bool burn_in, VariableSchedule * schedule){
+    SingleThreadSampler sampler = SingleThreadSampler(_p_fg, _sample_evidence, burn_in, false);
+    std::vector<double> pots(2 * n_worker);
+    HubBarrier barrier(n_worker);
+    // this thread sums the first slice, the other workers the rest
+    std::vector<std::thread> workers;
+    for(int i=1;i<n_worker;i++){
+      workers.push_back(std::thread(hub_slice_task, _p_fg, &schedule->hubs, i, n_worker,
+        pots.data(), &barrier));
+    }
+    for(size_t k=0;k<schedule->hubs.size();k++){
+      const Variable & variable = _p_fg->variables[schedule->hubs[k]];
+      hub_potential_task(_p_fg, &variable, 0, variable.n_factors / n_worker, &pots[0], &pots[1]);
+      barrier.wait();
+      double pot_neg = 0.0, pot_pos = 0.0;
+      for(int i=0;i<n_worker;i++){
+        pot_neg += pots[2*i];
+        pot_pos += pots[2*i+1];
+      }
+      sampler.sample_single_variable(variable.id, pot_neg, pot_pos);
+      // the next hub may share factors with this one
+      barrier.wait();
+    }
+    for(size_t i=0;i<workers.size();i++){
+      workers[i].join();
+    }
   }
 
   void gibbs_single_thread_sgd_task(FactorGraph * const _p_fg, int i_worker, int n_worker,
-    bool learn_non_evidence) {
+    bool learn_non_evidence, VariableSchedule * schedule, double minibatch_fraction) {
     SingleThreadSampler sampler = SingleThreadSampler(_p_fg, false, 0, learn_non_evidence);
-    sampler.sample_sgd(i_worker,n_worker);
+    if(schedule != NULL && minibatch_fraction < 1.0){
+      sampler.sample_sgd_minibatch(*schedule, i_worker, minibatch_fraction);
+    }else if(schedule != NULL){
+      sampler.sample_sgd(*schedule, i_worker);
+    }else{
+      sampler.sample_sgd(i_worker,n_worker);
+    }
   }
 
   SingleNodeSampler::SingleNodeSampler(FactorGraph * _p_fg, int _nthread, int _nodeid) :
-    p_fg (_p_fg), nthread(_nthread), nodeid(_nodeid) {}
+    p_fg (_p_fg), nthread(_nthread), nodeid(_nodeid), schedule(NULL), minibatch_fraction(1.0) {}
 
   SingleNodeSampler::SingleNodeSampler(FactorGraph * _p_fg, int _nthread, int _nodeid,
     bool sample_evidence, int burn_in) :
     p_fg (_p_fg), nthread(_nthread), nodeid(_nodeid), sample_evidence(sample_evidence),
-    burn_in(burn_in) {}
+    burn_in(burn_in), schedule(NULL), minibatch_fraction(1.0) {}
 
   SingleNodeSampler::SingleNodeSampler(FactorGraph * _p_fg, int _nthread, int _nodeid,
     bool sample_evidence, int burn_in, bool learn_non_evidence) :
     p_fg (_p_fg), nthread(_nthread), nodeid(_nodeid), sample_evidence(sample_evidence),
-    burn_in(burn_in), learn_non_evidence(learn_non_evidence) {}
+    burn_in(burn_in), learn_non_evidence(learn_non_evidence), schedule(NULL), minibatch_fraction(1.0) {}
 
   void SingleNodeSampler::clear_variabletally(){
     for(long i=0;i<p_fg->n_var;i++){
@@ -46,12 +136,22 @@ namespace dd{
 
     for(int i=0;i<this->nthread;i++){
       this->threads.push_back(std::thread(gibbs_single_thread_task, p_fg, i,
-        nthread, sample_evidence, is_burn_in));
+        nthread, sample_evidence, is_burn_in, schedule));
     }
   }
 
+  void SingleNodeSampler::sample_hubs(int i_epoch){
+    numa_run_on_node(this->nodeid);
+
+    this->threads.clear();
+    bool is_burn_in = i_epoch < burn_in;
+
+    this->threads.push_back(std::thread(gibbs_hub_task, p_fg, nthread, 
+      sample_evidence, is_burn_in, schedule));
+  }
+
   void SingleNodeSampler::wait(){
-    for(int i=0;i<this->nthread;i++){
+    for(size_t i=0;i<this->threads.size();i++){
       this->threads[i].join();
     }
   }
@@ -63,7 +163,7 @@ namespace dd{
 
     for(int i=0;i<this->nthread;i++){
       this->threads.push_back(std::thread(gibbs_single_thread_sgd_task, p_fg, i,
-        nthread, learn_non_evidence));
+        nthread, learn_non_evidence, schedule, minibatch_fraction));
     }
   }
 
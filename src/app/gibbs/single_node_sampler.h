@@ -26,6 +26,13 @@ namespace dd{
     int burn_in;
     bool learn_non_evidence;
 
+    // if set, the workers sample the variables of this schedule (which has
+    // nthread workers) instead of equal id ranges
+    VariableSchedule * schedule;
+
+    // fraction of its scheduled variables each worker samples per SGD epoch
+    double minibatch_fraction;
+
     std::vector<std::thread> threads;
 
     /**
@@ -49,7 +56,16 @@ namespace dd{
     void sample(int i_epoch);
 
     /**
-     * Waits for sample worker to finish
+     * Samples the hub variables of the schedule one after another. The
+     * potential of each is summed over nthread slices of its factors in
+     * parallel, so a variable with millions of factors does not hold up one
+     * worker for the whole epoch. The threads are started once for all hubs
+     * and meet at a barrier for each.
+     */
+    void sample_hubs(int i_epoch);
+
+    /**
+     * Waits for sample or sample_hubs worker to finish
      */
     void wait();
 
@@ -9,29 +9,114 @@ namespace dd{
     p_rand_seed[0] = rand();
     p_rand_seed[1] = rand();
     p_rand_seed[2] = rand();
+    has_hot_weights = p_fg->hot_weight_slots != NULL;
+    if(has_hot_weights){
+      p_fg->init_hot_gradients(hot_gradients);
+    }
+  }
+
+  void SingleThreadSampler::flush_hot_gradients(){
+    if(has_hot_weights){
+      p_fg->flush_hot_gradients(hot_gradients);
+    }
   }
 
   void SingleThreadSampler::sample(const int & i_sharding, const int & n_sharding){
     long nvar = p_fg->n_var;
     // calculates the start and end id in this partition
-    long start = ((long)(nvar/n_sharding)+1) * i_sharding;
-    long end = ((long)(nvar/n_sharding)+1) * (i_sharding+1);
+    // whole 64-variable words, so that bit-packed words have one writer
+    const long chunk = ((nvar/n_sharding)/64+1)*64;
+    long start = chunk * i_sharding;
+    long end = chunk * (i_sharding+1);
+    start = start > nvar ? nvar : start;
     end = end > nvar ? nvar : end;
 
     // sample each variable in the partition
-    for(long i=start; i<end; i++){
+    this->sample_variables(NULL, start, end);
+  }
+
+  void SingleThreadSampler::sample(const VariableSchedule & schedule, const int & i_worker){
+    this->sample_variables(schedule.vids.data(), schedule.bounds[i_worker], 
+      schedule.bounds[i_worker+1]);
+  }
+
+  void SingleThreadSampler::sample_variables(const long * const vids, long start, long end){
+    const bool prefetch = p_fg->prefetch_distance > 0;
+    if(p_fg->infrs->chains != NULL){
+      for(long k=start; k<end; k++){
+        if(prefetch) this->prefetch_ahead(vids, k, end, false);
+        this->sample_single_variable_chains(vids == NULL ? k : vids[k]);
+      }
+      return;
+    }
+    if(p_fg->infrs->scan_uncertainty == NULL){
+      for(long k=start; k<end; k++){
+        if(prefetch) this->prefetch_ahead(vids, k, end, false);
+        this->sample_single_variable(vids == NULL ? k : vids[k]);
+      }
+      return;
+    }
+
+    // adaptive scan, visit each variable with its scan probability
+    long n_visits = 0;
+    for(long k=start; k<end; k++){
+      if(prefetch) this->prefetch_ahead(vids, k, end, false);
+      const long i = vids == NULL ? k : vids[k];
+      const double q = p_fg->infrs->scan_prob(i);
+      if(q < 1.0 && erand48(this->p_rand_seed) >= q) continue;
+      const Variable & variable = p_fg->variables[i];
+      if(!variable.is_observation && (!variable.is_evid || sample_evidence)){
+        n_visits ++;
+      }
       this->sample_single_variable(i);
     }
+    __sync_fetch_and_add(&p_fg->infrs->n_visits, n_visits);
   }
 
   void SingleThreadSampler::sample_sgd(const int & i_sharding, const int & n_sharding){
     long nvar = p_fg->n_var;
-    long start = ((long)(nvar/n_sharding)+1) * i_sharding;
-    long end = ((long)(nvar/n_sharding)+1) * (i_sharding+1);
+    // whole 64-variable words, so that bit-packed words have one writer
+    const long chunk = ((nvar/n_sharding)/64+1)*64;
+    long start = chunk * i_sharding;
+    long end = chunk * (i_sharding+1);
+    start = start > nvar ? nvar : start;
     end = end > nvar ? nvar : end;
+    const bool prefetch = p_fg->prefetch_distance > 0;
     for(long i=start; i<end; i++){
+      if(prefetch) this->prefetch_ahead(NULL, i, end, true);
       this->sample_sgd_single_variable(i);
     }
+    this->flush_hot_gradients();
+  }
+
+  void SingleThreadSampler::sample_sgd(const VariableSchedule & schedule, const int & i_worker){
+    const bool prefetch = p_fg->prefetch_distance > 0;
+    const long end = schedule.bounds[i_worker+1];
+    for(long k=schedule.bounds[i_worker]; k<end; k++){
+      if(prefetch) this->prefetch_ahead(schedule.vids.data(), k, end, true);
+      this->sample_sgd_single_variable(schedule.vids[k]);
+    }
+    this->flush_hot_gradients();
+  }
+
+  void SingleThreadSampler::sample_sgd_minibatch(VariableSchedule & schedule, 
+    const int & i_worker, const double & fraction){
+    const long start = schedule.bounds[i_worker];
+    const long n = schedule.bounds[i_worker+1] - start;
+    const long n_batch = schedule.batch_size(i_worker, fraction);
+    long * const vids = schedule.vids.data() + start;
+    for(long k=0; k<n_batch; k++){
+      long r = k + (long)(erand48(this->p_rand_seed) * (n - k));
+      if(r >= n) r = n - 1;
+      std::swap(vids[k], vids[r]);
+    }
+    // the batch is known up front, so it can be prefetched like a full epoch
+    const bool prefetch = p_fg->prefetch_distance > 0;
+    for(long k=0; k<n_batch; k++){
+      if(prefetch) this->prefetch_ahead(vids, k, n_batch, true);
+      this->sample_sgd_single_variable(vids[k]);
+    }
+    this->flush_hot_gradients();
   }
 
   void SingleThreadSampler::sample_sgd_single_variable(long vid){
@@ -46,13 +131,17 @@ namespace dd{
     if (variable.is_observation) return;
     if (!learn_non_evidence && !variable.is_evid) return;
 
+    // the factors are evaluated once per assignment, for both sampling and
+    // the gradient, see FactorGraph::factor_values()
+    p_fg->template factor_values<false>(variable, values_evid);
+
     if(variable.domain_type == DTYPE_BOOLEAN){ // boolean
 
         // sample the variable with evidence unchanged
         if(variable.is_evid == false){
           // calculate the potential if the variable is positive or negative
-          potential_pos = p_fg->template potential<false>(variable, 1);
-          potential_neg = p_fg->template potential<false>(variable, 0);
+          potential_pos = values_evid.potentials[1];
+          potential_neg = values_evid.potentials[0];
           *this->p_rand_obj_buf = erand48(this->p_rand_seed);
 
           // sample the variable
@@ -68,8 +157,9 @@ namespace dd{
         }
 
         // sample the variable regardless of whether it's evidence
-        potential_pos_freeevid = p_fg->template potential<true>(variable, 1);
-        potential_neg_freeevid = p_fg->template potential<true>(variable, 0);
+        p_fg->template factor_values<true>(variable, values_free);
+        potential_pos_freeevid = values_free.potentials[1];
+        potential_neg_freeevid = values_free.potentials[0];
 
         *this->p_rand_obj_buf = erand48(this->p_rand_seed);
         if((*this->p_rand_obj_buf) * (1.0 + exp(potential_neg_freeevid-potential_pos_freeevid)) < 1.0){
@@ -78,15 +168,11 @@ namespace dd{
           p_fg->template update<true>(variable, 0.0);
         }
 
-        this->p_fg->update_weight(variable);
+        this->p_fg->update_weight(variable, values_evid, values_free, 
+          has_hot_weights ? &hot_gradients : NULL);
         
     }else if(variable.domain_type == DTYPE_MULTINOMIAL){ // multinomial
 
-      // varlen_potential_buffer contains potential for each proposals
-      while(variable.upper_bound >= varlen_potential_buffer.size()){
-        varlen_potential_buffer.push_back(0.0);
-      }
-
       if(variable.is_evid == false){
         sum = -100000.0;
         acc = 0.0;
@@ -94,14 +180,13 @@ namespace dd{
         
         // calculate potential for each proposal
         for(int propose=variable.lower_bound;propose <= variable.upper_bound; propose++){
-          varlen_potential_buffer[propose] = p_fg->template potential<false>(variable, propose);
-          sum = logadd(sum, varlen_potential_buffer[propose]);
+          sum = logadd(sum, values_evid.potentials[propose - variable.lower_bound]);
         }
 
         // flip a coin
         *this->p_rand_obj_buf = erand48(this->p_rand_seed);
         for(int propose=variable.lower_bound;propose <= variable.upper_bound; propose++){
-          acc += exp(varlen_potential_buffer[propose]-sum);
+          acc += exp(values_evid.potentials[propose - variable.lower_bound]-sum);
           if(*this->p_rand_obj_buf <= acc){
             multi_proposal = propose;
             break;
@@ -111,17 +196,17 @@ namespace dd{
         p_fg->update_evid(variable, multi_proposal);
       }
 
+      p_fg->template factor_values<true>(variable, values_free);
       sum = -100000.0;
       acc = 0.0;
       multi_proposal = -1;
       for(int propose=variable.lower_bound;propose <= variable.upper_bound; propose++){
-        varlen_potential_buffer[propose] = p_fg->template potential<true>(variable, propose);
-        sum = logadd(sum, varlen_potential_buffer[propose]);
+        sum = logadd(sum, values_free.potentials[propose - variable.lower_bound]);
       }
 
       *this->p_rand_obj_buf = erand48(this->p_rand_seed);
       for(int propose=variable.lower_bound; propose <= variable.upper_bound; propose++){
-        acc += exp(varlen_potential_buffer[propose]-sum);
+        acc += exp(values_free.potentials[propose - variable.lower_bound]-sum);
         if(*this->p_rand_obj_buf <= acc){
           multi_proposal = propose;
           break;
@@ -130,14 +215,73 @@ namespace dd{
       assert(multi_proposal != -1);
       p_fg->template update<true>(variable, multi_proposal);
 
-      this->p_fg->update_weight(variable);
+      this->p_fg->update_weight(variable, values_evid, values_free, 
+        has_hot_weights ? &hot_gradients : NULL);
 
     }else{
       std::cerr << "[ERROR] Only Boolean and Multinomial variables are supported now!" << std::endl;
       assert(false);
       return;
     } // end if for variable types
-    
+
+    if(has_hot_weights && ++hot_gradients.n_pending >= HotGradients::flush_interval){
+      p_fg->flush_hot_gradients(hot_gradients);
+    }
+  }
+
+  void SingleThreadSampler::sample_single_variable_chains(long vid){
+    Variable & variable = this->p_fg->variables[vid];
+    if (variable.is_observation) return;
+    if (variable.is_evid && !sample_evidence) return;
+
+    InferenceResult & infrs = *p_fg->infrs;
+    const int n_chains = infrs.chains->nchains;
+    chain_potential_buffer.resize(2 * n_chains);
+    double * const pot_neg = chain_potential_buffer.data();
+    double * const pot_pos = pot_neg + n_chains;
+    p_fg->chain_potentials(variable, pot_neg, pot_pos);
+
+    // same sampling as sample_single_variable(), once per chain
+    for(int c=0;c<n_chains;c++){
+      *this->p_rand_obj_buf = erand48(this->p_rand_seed);
+      const double new_value = 
+        (*this->p_rand_obj_buf) * (1.0 + exp(pot_neg[c]-pot_pos[c])) < 1.0 ? 1.0 : 0.0;
+      infrs.chains->set(vid, c, new_value);
+      if (!burn_in) {
+        const double estimate = infrs.rao_blackwell ? 
+          1.0 / (1.0 + exp(pot_neg[c]-pot_pos[c])) : new_value;
+        infrs.agg_means[vid] += estimate;
+        infrs.chain_means[vid * n_chains + c] += estimate;
+      }
+    }
+    if (!burn_in) {
+      infrs.agg_nsamples[vid] += n_chains;
+    }
+  }
+
+  void SingleThreadSampler::sample_single_variable(long vid, const double & pot_neg,
+    const double & pot_pos){
+    Variable & variable = this->p_fg->variables[vid];
+    potential_neg = pot_neg;
+    potential_pos = pot_pos;
+
+    *this->p_rand_obj_buf = erand48(this->p_rand_seed);
+    const double new_value = 
+      (*this->p_rand_obj_buf) * (1.0 + exp(potential_neg-potential_pos)) < 1.0 ? 1.0 : 0.0;
+    const bool is_weighted = p_fg->infrs->rao_blackwell || p_fg->infrs->scan_uncertainty != NULL;
+    if (burn_in) {
+      p_fg->update_evid(variable, new_value);
+    } else if (is_weighted) {
+      const double p_true = 1.0 / (1.0 + exp(potential_neg-potential_pos));
+      p_fg->update_weighted(variable, new_value, 
+        p_fg->infrs->rao_blackwell ? p_true : new_value,
+        1.0 / p_fg->infrs->scan_prob(variable.id));
+    } else {
+      p_fg->template update<false>(variable, new_value);
+    }
+    if (p_fg->infrs->scan_uncertainty != NULL) {
+      p_fg->infrs->update_scan(variable.id, 1.0 / (1.0 + exp(potential_neg-potential_pos)));
+    }
   }
 
   void SingleThreadSampler::sample_single_variable(long vid){
@@ -151,23 +295,8 @@ namespace dd{
 
       if(variable.is_evid == false || sample_evidence){
 
-        potential_pos = p_fg->template potential<false>(variable, 1);
-        potential_neg = p_fg->template potential<false>(variable, 0);
-
-        *this->p_rand_obj_buf = erand48(this->p_rand_seed);
-        if((*this->p_rand_obj_buf) * (1.0 + exp(potential_neg-potential_pos)) < 1.0){
-          if (burn_in) {
-            p_fg->update_evid(variable, 1.0);
-          } else {
-            p_fg->template update<false>(variable, 1.0);
-          }
-        }else{
-          if (burn_in) {
-            p_fg->update_evid(variable, 0.0);
-          } else {
-            p_fg->template update<false>(variable, 0.0);
-          }
-        }
+        this->sample_single_variable(vid, p_fg->template potential<false>(variable, 0),
+          p_fg->template potential<false>(variable, 1));
 
       }
 
@@ -195,7 +324,11 @@ namespace dd{
           }
         }
         assert(multi_proposal != -1);
-        p_fg->template update<false>(variable, multi_proposal);
+        if (p_fg->infrs->rao_blackwell) {
+          p_fg->update_rao_blackwell(variable, multi_proposal, varlen_potential_buffer, sum);
+        } else {
+          p_fg->template update<false>(variable, multi_proposal);
+        }
       }
 
     }else{
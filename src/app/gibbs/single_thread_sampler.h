@@ -1,5 +1,6 @@
 
 #include "dstruct/factor_graph/factor_graph.h"
+#include "app/gibbs/variable_schedule.h"
 #include "timer.h"
 #include "common.h"
 
@@ -41,6 +42,14 @@ namespace dd{
     // (used for multinomial), see .cpp for more detail
     // TODO: this shouldn't be a class member
     std::vector<double> varlen_potential_buffer;
+    // factor potentials captured in learning, see sample_sgd_single_variable()
+    FactorValues values_evid;
+    FactorValues values_free;
+    // per-thread gradients of the hot weights, if the graph has any
+    HotGradients hot_gradients;
+    bool has_hot_weights;
+    // potentials of each chain, see sample_single_variable_chains()
+    std::vector<double> chain_potential_buffer;
 
     // these are used for calculating potentials and probabilities
     // see single_thread_sampler.cpp for more detail
@@ -67,6 +76,11 @@ namespace dd{
      */ 
     void sample(const int & i_sharding, const int & n_sharding);
 
+    /**
+     * Samples the variables of the i_worker-th worker in the given schedule
+     */
+    void sample(const VariableSchedule & schedule, const int & i_worker);
+
     /**
      * Performs SGD with by sampling variables.  The variables are divided into 
      * n_sharding equal partitions based on their ids. This function samples variables 
@@ -74,6 +88,21 @@ namespace dd{
      */
     void sample_sgd(const int & i_sharding, const int & n_sharding);
 
+    /**
+     * Performs SGD by sampling the variables of the i_worker-th worker in the
+     * given schedule
+     */
+    void sample_sgd(const VariableSchedule & schedule, const int & i_worker);
+
+    /**
+     * Performs SGD on a random fraction of the variables of the i_worker-th
+     * worker in the given schedule. The minibatch is drawn with a partial
+     * Fisher-Yates shuffle of the worker's range, in place, before any of
+     * it is sampled, so that it is prefetched like sample_sgd().
+     */
+    void sample_sgd_minibatch(VariableSchedule & schedule, const int & i_worker, 
+      const double & fraction);
+
     /**
      * Performs SGD by sampling a single variable with id vid
      */
@@ -84,6 +113,43 @@ namespace dd{
      */
     void sample_single_variable(long vid);
 
+    /**
+     * Samples a single Boolean variable with id vid given the potentials of
+     * its two values, e.g. summed by several threads for a hub variable
+     */
+    void sample_single_variable(long vid, const double & pot_neg, const double & pot_pos);
+
+    /**
+     * Samples a single Boolean variable with id vid in all chains of
+     * infrs->chains
+     */
+    void sample_single_variable_chains(long vid);
+
+  private:
+    /**
+     * Samples the variables vids[start] to vids[end-1], or the variables with
+     * id start to end-1 if vids is NULL
+     */
+    void sample_variables(const long * const vids, long start, long end);
+
+    /**
+     * Prefetches for the variables after the k-th of vids[start] to
+     * vids[end-1] (ids k to end-1 if vids is NULL), see FactorGraph::prefetch()
+     */
+    inline void prefetch_ahead(const long * const vids, const long & k, const long & end,
+      const bool & is_learning){
+      const long d = p_fg->prefetch_distance;
+      for(int stage=0;stage<4;stage++){
+        const long j = k + (4-stage)*d;
+        if(j < end) p_fg->prefetch(vids == NULL ? j : vids[j], stage, is_learning);
+      }
+    }
+
+    /**
+     * Applies the pending gradients of the hot weights, if any
+     */
+    void flush_hot_gradients();
+
   };
 
 }
@@ -0,0 +1,27 @@
+#include "app/gibbs/variable_distributions.h"
+
+void dd::VariableDistributions::init_distributions(const FactorGraph & fg){
+  q_start.resize(fg.n_var + 1);
+  q_start[0] = 0;
+  for(long i=0;i<fg.n_var;i++){
+    q_start[i+1] = q_start[i] + fg.variables[i].upper_bound + 1;
+  }
+  q.assign(q_start[fg.n_var], 0.0);
+}
+
+void dd::VariableDistributions::write_marginals(const FactorGraph & fg,
+  InferenceResult & infrs) const{
+  for(size_t k=0;k<vids.size();k++){
+    const Variable & variable = fg.variables[vids[k]];
+    infrs.agg_nsamples[variable.id] = 1;
+    infrs.agg_means[variable.id] = 0;
+    for(long x=0;x<=variable.upper_bound;x++){
+      infrs.agg_means[variable.id] += x * q[q_start[variable.id] + x];
+    }
+    if(variable.domain_type == DTYPE_MULTINOMIAL){
+      for(long x=0;x<=variable.upper_bound;x++){
+        infrs.multinomial_tallies[variable.n_start_i_tally + x] = q[q_start[variable.id] + x];
+      }
+    }
+  }
+}
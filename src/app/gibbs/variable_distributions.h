@@ -0,0 +1,37 @@
+#include <vector>
+#include "dstruct/factor_graph/factor_graph.h"
+
+#ifndef _VARIABLE_DISTRIBUTIONS_H_
+#define _VARIABLE_DISTRIBUTIONS_H_
+
+namespace dd{
+
+  /**
+   * A distribution over the values of each variable, the marginals the
+   * deterministic engines (MeanField, ExactInference) compute in place of
+   * gibbs samples
+   */
+  class VariableDistributions {
+  public:
+    // q[q_start[vid] + value] for value in [0, upper_bound]
+    std::vector<long> q_start;
+    std::vector<double> q;
+
+    // the variables whose distributions are computed
+    std::vector<long> vids;
+
+    /**
+     * Sizes q for the variables of fg, with all probabilities 0
+     */
+    void init_distributions(const FactorGraph & fg);
+
+    /**
+     * Writes the distributions of vids, variables of fg, as one sample each
+     * into the marginal tallies of infrs, which must be cleared
+     */
+    void write_marginals(const FactorGraph & fg, InferenceResult & infrs) const;
+  };
+
+}
+
+#endif
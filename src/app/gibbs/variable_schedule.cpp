@@ -0,0 +1,250 @@
+#include "app/gibbs/variable_schedule.h"
+#include <stdlib.h>
+#include <algorithm>
+
+void dd::VariableSchedule::build_learning(const FactorGraph & fg, bool learn_non_evidence,
+  int n_worker){
+  vids.clear();
+  hubs.clear();
+  exact.clear();
+  exact_bounds.clear();
+  component_bounds.clear();
+  for(long i=0;i<fg.n_var;i++){
+    const Variable & variable = fg.variables[i];
+    if(!variable.is_observation && (variable.is_evid || learn_non_evidence)){
+      vids.push_back(i);
+    }
+  }
+  balance(fg, n_worker);
+}
+
+void dd::VariableSchedule::build_inference(const FactorGraph & fg, bool sample_evidence,
+  int n_worker){
+  vids.clear();
+  hubs.clear();
+  exact.clear();
+  exact_bounds.clear();
+  component_bounds.clear();
+  for(long i=0;i<fg.n_var;i++){
+    const Variable & variable = fg.variables[i];
+    if(!variable.is_observation && (!variable.is_evid || sample_evidence)){
+      vids.push_back(i);
+    }
+  }
+  balance(fg, n_worker);
+}
+
+std::vector<long> dd::VariableSchedule::split_holdout(const FactorGraph & fg, 
+  double fraction, int n_worker){
+  std::vector<long> holdout;
+  if(fraction <= 0) return holdout;
+
+  unsigned short seed[3] = {0x330e, 0xabcd, 0x1234};
+  std::vector<long> kept;
+  for(size_t k=0;k<vids.size();k++){
+    if(fg.variables[vids[k]].is_evid && erand48(seed) < fraction){
+      holdout.push_back(vids[k]);
+    }else{
+      kept.push_back(vids[k]);
+    }
+  }
+  vids.swap(kept);
+  component_bounds.clear();
+  balance(fg, n_worker);
+  return holdout;
+}
+
+void dd::VariableSchedule::split_hubs(const FactorGraph & fg, long threshold, 
+  int n_worker){
+  hubs.clear();
+  std::vector<long> kept;
+  for(size_t k=0;k<vids.size();k++){
+    const Variable & variable = fg.variables[vids[k]];
+    if(variable.domain_type == DTYPE_BOOLEAN && variable.n_factors >= threshold){
+      hubs.push_back(vids[k]);
+    }else{
+      kept.push_back(vids[k]);
+    }
+  }
+  vids.swap(kept);
+  component_bounds.clear();
+  balance(fg, n_worker);
+}
+
+std::vector<long> dd::VariableSchedule::find_components(const FactorGraph & fg) const{
+  // union-find forest over the scheduled variables, -1 for the others
+  std::vector<long> parent(fg.n_var, -1);
+  for(size_t k=0;k<vids.size();k++){
+    parent[vids[k]] = vids[k];
+  }
+  auto find = [&](long vid){
+    while(parent[vid] != vid){
+      parent[vid] = parent[parent[vid]];
+      vid = parent[vid];
+    }
+    return vid;
+  };
+  for(size_t k=0;k<vids.size();k++){
+    const Variable & variable = fg.variables[vids[k]];
+    for(long i=variable.n_start_i_factors;i<variable.n_start_i_factors+variable.n_factors;i++){
+      const CompactFactor & factor = fg.compact_factors[i];
+      for(long j=factor.n_start_i_vif;j<factor.n_start_i_vif+factor.n_variables;j++){
+        const long vid = fg.vifs[j].vid;
+        if(parent[vid] < 0) continue;
+        const long a = find(vid), b = find(variable.id);
+        if(a != b) parent[a] = b;
+      }
+    }
+  }
+  for(size_t k=0;k<vids.size();k++){
+    parent[vids[k]] = find(vids[k]);
+  }
+  return parent;
+}
+
+void dd::VariableSchedule::split_exact(const FactorGraph & fg, long threshold,
+  long max_configs, int n_worker){
+  const std::vector<long> root_of = find_components(fg);
+
+  // size and joint values of each component, at its root
+  std::vector<long> size(fg.n_var, 0), configs(fg.n_var, 1);
+  for(size_t k=0;k<vids.size();k++){
+    const long root = root_of[vids[k]];
+    size[root] ++;
+    configs[root] = std::min(configs[root] * (fg.variables[vids[k]].upper_bound + 1),
+      max_configs + 1);
+  }
+
+  // the members of each small component, in order of its first member
+  exact.clear();
+  exact_bounds.assign(1, 0);
+  std::vector<long> kept;
+  std::vector<long> start(fg.n_var, -1);
+  for(size_t k=0;k<vids.size();k++){
+    const long root = root_of[vids[k]];
+    if(size[root] > threshold || configs[root] > max_configs){
+      kept.push_back(vids[k]);
+    }else if(start[root] < 0){
+      start[root] = exact_bounds.size() - 1;
+      exact_bounds.push_back(exact_bounds.back() + size[root]);
+    }
+  }
+  exact.resize(exact_bounds.back());
+  std::vector<long> next(exact_bounds.begin(), exact_bounds.end() - 1);
+  for(size_t k=0;k<vids.size();k++){
+    const long root = root_of[vids[k]];
+    if(start[root] >= 0){
+      exact[next[start[root]] ++] = vids[k];
+    }
+  }
+  vids.swap(kept);
+  balance(fg, n_worker);
+}
+
+void dd::VariableSchedule::order_by_component(const FactorGraph & fg, int n_worker){
+  const std::vector<long> root_of = find_components(fg);
+
+  // count the members of each component, numbered in order of their first
+  std::vector<long> index(fg.n_var, -1);
+  component_bounds.assign(1, 0);
+  for(size_t k=0;k<vids.size();k++){
+    const long root = root_of[vids[k]];
+    if(index[root] < 0){
+      index[root] = component_bounds.size() - 1;
+      component_bounds.push_back(0);
+    }
+    component_bounds[index[root] + 1] ++;
+  }
+  for(size_t c=1;c<component_bounds.size();c++){
+    component_bounds[c] += component_bounds[c-1];
+  }
+
+  std::vector<long> ordered(vids.size());
+  std::vector<long> next(component_bounds.begin(), component_bounds.end() - 1);
+  for(size_t k=0;k<vids.size();k++){
+    ordered[next[index[root_of[vids[k]]]] ++] = vids[k];
+  }
+  vids.swap(ordered);
+  balance(fg, n_worker);
+}
+
+long dd::VariableSchedule::remove_components(const FactorGraph & fg,
+  const std::vector<bool> & is_removed, int n_worker){
+  std::vector<long> kept, kept_bounds(1, 0);
+  long n_removed = 0;
+  for(size_t c=0;c+1<component_bounds.size();c++){
+    if(is_removed[c]){
+      n_removed ++;
+      continue;
+    }
+    kept.insert(kept.end(), vids.begin() + component_bounds[c], vids.begin() + component_bounds[c+1]);
+    kept_bounds.push_back(kept.size());
+  }
+  vids.swap(kept);
+  component_bounds.swap(kept_bounds);
+  balance(fg, n_worker);
+  return n_removed;
+}
+
+void dd::VariableSchedule::balance(const FactorGraph & fg, int n_worker){
+  long total = 0;
+  for(size_t k=0;k<vids.size();k++){
+    total += fg.variables[vids[k]].n_factors + 1;
+  }
+
+  // worker i starts at the first variable whose prefix cost reaches 
+  // i/n_worker of the total
+  bounds.assign(n_worker + 1, vids.size());
+  bounds[0] = 0;
+  long cost = 0;
+  int i_worker = 1;
+  for(size_t k=0;k<vids.size() && i_worker<n_worker;k++){
+    while(i_worker < n_worker && cost * n_worker >= total * i_worker){
+      bounds[i_worker ++] = k;
+    }
+    cost += fg.variables[vids[k]].n_factors + 1;
+  }
+
+  // in id order, a bound inside a 64-variable word moves back to the start
+  // of the word, so that words of bit-packed assignments have one writer;
+  // not for less than a word per worker, which would leave workers idle
+  if((long) vids.size() >= 64 * n_worker && std::is_sorted(vids.begin(), vids.end())){
+    for(int i=1;i<n_worker;i++){
+      long k = bounds[i];
+      while(k > bounds[i-1] && k < (long) vids.size() && (vids[k] >> 6) == (vids[k-1] >> 6)){
+        k --;
+      }
+      bounds[i] = k;
+    }
+  }
+
+  // by component, a bound inside a component of less than half a worker's
+  // share moves back to its start, so that small ones stay on one worker
+  if(component_bounds.empty()) return;
+  for(int i=1;i<n_worker;i++){
+    const long k = bounds[i];
+    const size_t c = std::upper_bound(component_bounds.begin(), component_bounds.end(), k)
+      - component_bounds.begin() - 1;
+    if(c + 1 >= component_bounds.size() || component_bounds[c] == k) continue;
+    long component_cost = 0;
+    for(long j=component_bounds[c];j<component_bounds[c+1];j++){
+      component_cost += fg.variables[vids[j]].n_factors + 1;
+    }
+    if(component_cost * 2 * n_worker < total){
+      bounds[i] = std::max(bounds[i-1], component_bounds[c]);
+    }
+  }
+}
+
+bool dd::VariableSchedule::is_word_aligned() const{
+  std::vector<int> owner;
+  for(size_t i=0;i+1<bounds.size();i++){
+    for(long k=bounds[i];k<bounds[i+1];k++){
+      const long word = vids[k] >> 6;
+      if(word >= (long) owner.size()) owner.resize(word + 1, -1);
+      if(owner[word] >= 0 && owner[word] != (int) i) return false;
+      owner[word] = i;
+    }
+  }
+  return true;
+}
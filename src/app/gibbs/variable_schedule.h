@@ -0,0 +1,118 @@
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include "dstruct/factor_graph/factor_graph.h"
+
+#ifndef _VARIABLE_SCHEDULE_H_
+#define _VARIABLE_SCHEDULE_H_
+
+namespace dd{
+
+  /**
+   * The variables a sampling phase actually visits, split among workers.
+   *
+   * vids lists the active variables in id order, or by connected component
+   * after order_by_component(), and worker i visits
+   * vids[bounds[i]] to vids[bounds[i+1]-1]. The bounds are chosen so that
+   * each worker gets about the same number of edges (plus one per variable),
+   * as the cost of sampling a variable grows with its factors.
+   */
+  class VariableSchedule {
+  public:
+    std::vector<long> vids;
+    std::vector<long> bounds;
+    // variables sampled by all workers together, see split_hubs()
+    std::vector<long> hubs;
+    // variables solved exactly instead, by component: component i is
+    // exact[exact_bounds[i]] to exact[exact_bounds[i+1]-1], see split_exact()
+    std::vector<long> exact;
+    std::vector<long> exact_bounds;
+    // after order_by_component(), component i is vids[component_bounds[i]]
+    // to vids[component_bounds[i+1]-1]; empty otherwise
+    std::vector<long> component_bounds;
+
+    /**
+     * Schedules the variables sample_sgd_single_variable() does not skip:
+     * variables other than observations that are evidence, or any if
+     * learn_non_evidence is set
+     */
+    void build_learning(const FactorGraph & fg, bool learn_non_evidence, int n_worker);
+
+    /**
+     * Schedules the variables sample_single_variable() does not skip:
+     * variables other than observations that are not evidence, or any if
+     * sample_evidence is set. Build after the inference view is in use, so
+     * the workers are balanced on its edges.
+     */
+    void build_inference(const FactorGraph & fg, bool sample_evidence, int n_worker);
+
+    /**
+     * Removes a random fraction of the scheduled evidence variables, which
+     * are returned in id order, and splits the rest again among n_worker
+     * workers. The selection only depends on the graph, not on the run.
+     */
+    std::vector<long> split_holdout(const FactorGraph & fg, double fraction, int n_worker);
+
+    /**
+     * Returns whether no two workers have variables in the same 64-variable
+     * word, so that each word of a BitAssignment has a single writer.
+     * balance() aligns the bounds to words when vids is in id order.
+     */
+    bool is_word_aligned() const;
+
+    /**
+     * Returns the number of variables the i_worker-th worker samples in a
+     * minibatch of the given fraction, at least one if it has any
+     */
+    inline long batch_size(int i_worker, double fraction) const {
+      long n = bounds[i_worker+1] - bounds[i_worker];
+      return std::min(n, (long) ceil(n * fraction));
+    }
+
+    /**
+     * Moves the scheduled Boolean variables with at least threshold factors
+     * to hubs, in id order, and splits the rest again among n_worker workers
+     */
+    void split_hubs(const FactorGraph & fg, long threshold, int n_worker);
+
+    /**
+     * Moves the scheduled variables of the small connected components to
+     * exact, and splits the rest again among n_worker workers. Components
+     * are connected by the factors among scheduled variables, the others
+     * are fixed and separate them. A component is small if it has at most
+     * threshold variables and max_configs joint values.
+     */
+    void split_exact(const FactorGraph & fg, long threshold, long max_configs, int n_worker);
+
+    /**
+     * Orders vids by connected component (see split_exact()), in order of
+     * their first variable, and splits them again among n_worker workers.
+     * Workers then get whole components where they are small enough, and
+     * share the large ones.
+     */
+    void order_by_component(const FactorGraph & fg, int n_worker);
+
+    /**
+     * Removes the components c with is_removed[c] from vids, splits the
+     * rest again among n_worker workers, and returns how many were removed
+     */
+    long remove_components(const FactorGraph & fg, const std::vector<bool> & is_removed,
+      int n_worker);
+
+  private:
+    /**
+     * Returns the root of the connected component of each scheduled
+     * variable, by id, and -1 for the others
+     */
+    std::vector<long> find_components(const FactorGraph & fg) const;
+
+    /**
+     * Splits vids into n_worker ranges of about the same number of edges,
+     * keeping small components whole if vids is ordered by component
+     */
+    void balance(const FactorGraph & fg, int n_worker);
+  };
+
+}
+
+#endif
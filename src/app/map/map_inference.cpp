@@ -0,0 +1,155 @@
+#include "app/map/map_inference.h"
+#include "app/gibbs/single_node_sampler.h"
+#include "app/gibbs/variable_schedule.h"
+#include "timer.h"
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#include <math.h>
+#include <string.h>
+
+// computes the untempered log potential of the given variables of a copy
+static void map_log_potential_task(dd::FactorGraph * const fg,
+  const std::vector<long> * const vids, double * const log_pot){
+  *log_pot = fg->log_potential(*vids) / fg->inverse_temperature;
+}
+
+dd::MapInference::MapInference(FactorGraph * const _p_fg, GibbsSampling * const _gibbs,
+  double start_temperature, double end_temperature)
+  : p_fg(_p_fg), gibbs(_gibbs), start_temperature(start_temperature),
+    end_temperature(end_temperature), best_log_potential(-INFINITY) {}
+
+void dd::MapInference::anneal(const int & n_epoch, const bool is_quiet){
+
+  Timer t_total;
+
+  std::vector<FactorGraph> & factorgraphs = gibbs->factorgraphs;
+  const int nnode = gibbs->n_numa_nodes + 1;
+
+  // the copies never collect samples, every epoch counts as burn-in
+  std::vector<SingleNodeSampler> single_node_samplers;
+  for(int i=0;i<nnode;i++){
+    single_node_samplers.push_back(SingleNodeSampler(&factorgraphs[i],
+      gibbs->n_thread_per_numa, i % gibbs->n_nodes, gibbs->sample_evidence, n_epoch));
+    factorgraphs[i].infrs->pack_assignments();
+    factorgraphs[i].use_inference_view(true);
+    factorgraphs[i].update_unary_bias();
+  }
+
+  VariableSchedule schedule;
+  schedule.build_inference(factorgraphs[0], gibbs->sample_evidence, gibbs->n_thread_per_numa);
+  for(int i=0;i<nnode;i++){
+    single_node_samplers[i].schedule = &schedule;
+    factorgraphs[i].infrs->share_bit_words(!schedule.is_word_aligned());
+  }
+  vids = schedule.vids;
+  best_assignment.assign(p_fg->n_var, 0);
+  best_log_potential = -INFINITY;
+
+  for(int i_epoch=0;i_epoch<n_epoch;i_epoch++){
+    // geometric schedule from start_temperature to end_temperature
+    const double temperature = n_epoch == 1 ? end_temperature : start_temperature *
+      pow(end_temperature / start_temperature, (double) i_epoch / (n_epoch - 1));
+    for(int i=0;i<nnode;i++){
+      factorgraphs[i].inverse_temperature = 1.0 / temperature;
+      single_node_samplers[i].sample(i_epoch);
+    }
+    for(int i=0;i<nnode;i++){
+      single_node_samplers[i].wait();
+    }
+
+    // keep the best assignment of any copy
+    std::vector<double> log_pots(nnode);
+    std::vector<std::thread> threads;
+    for(int i=0;i<nnode;i++){
+      threads.push_back(std::thread(map_log_potential_task, &factorgraphs[i],
+        &vids, &log_pots[i]));
+    }
+    for(int i=0;i<nnode;i++){
+      threads[i].join();
+    }
+    for(int i=0;i<nnode;i++){
+      if(log_pots[i] > best_log_potential){
+        best_log_potential = log_pots[i];
+        const InferenceResult & infrs = *factorgraphs[i].infrs;
+        for(long j=0;j<p_fg->n_var;j++){
+          best_assignment[j] = infrs.is_packed ?
+            (*infrs.assignments_evid_bits)[j] : infrs.assignments_evid[j];
+        }
+      }
+    }
+
+    if (!is_quiet) {
+      std::cout << std::setprecision(4) << "ANNEALING EPOCH " << i_epoch
+        << ",T=" << temperature << ",BEST LOG POTENTIAL=" << best_log_potential << std::endl;
+    }
+  }
+
+  for(int i=0;i<nnode;i++){
+    factorgraphs[i].inverse_temperature = 1.0;
+    factorgraphs[i].infrs->unpack_assignments();
+  }
+
+  // greedy improvement of the best assignment, on the first copy
+  FactorGraph & fg = factorgraphs[0];
+  memcpy(fg.infrs->assignments_evid, best_assignment.data(), sizeof(VariableValue)*fg.n_var);
+  const int n_sweeps = icm(fg, 100);
+  best_log_potential = fg.log_potential(vids);
+  memcpy(best_assignment.data(), fg.infrs->assignments_evid, sizeof(VariableValue)*fg.n_var);
+  if (!is_quiet) {
+    std::cout << "ICM SWEEPS: " << n_sweeps << std::endl;
+  }
+
+  for(int i=0;i<nnode;i++){
+    factorgraphs[i].use_inference_view(false);
+  }
+  memcpy(p_fg->infrs->assignments_evid, best_assignment.data(), sizeof(VariableValue)*p_fg->n_var);
+
+  std::cout << "MAP ENERGY: " << -best_log_potential << std::endl;
+  std::cout << "TOTAL MAP INFERENCE TIME: " << t_total.elapsed() << " sec." << std::endl;
+}
+
+int dd::MapInference::icm(FactorGraph & fg, int max_sweeps){
+  int n_sweeps = 0;
+  bool is_changed = true;
+  while(is_changed && n_sweeps < max_sweeps){
+    is_changed = false;
+    n_sweeps ++;
+    for(size_t k=0;k<vids.size();k++){
+      Variable & variable = fg.variables[vids[k]];
+      const VariableValue value = fg.infrs->assignments_evid[variable.id];
+      // ties keep the current value
+      VariableValue best_value = value;
+      double best_pot = fg.template potential<false>(variable, value);
+      for(int propose=variable.lower_bound;propose<=variable.upper_bound;propose++){
+        const double pot = fg.template potential<false>(variable, propose);
+        if(pot > best_pot){
+          best_pot = pot;
+          best_value = propose;
+        }
+      }
+      if(best_value != value){
+        fg.update_evid(variable, best_value);
+        is_changed = true;
+      }
+    }
+  }
+  return n_sweeps;
+}
+
+void dd::MapInference::dump(const bool is_quiet){
+  const std::string output_folder = gibbs->p_cmd_parser->output_folder->getValue();
+  std::string filename_text = output_folder + "/map_result.out.text";
+  std::cout << "DUMPING... TEXT    : " << filename_text << std::endl;
+  std::ofstream fout_text(filename_text.c_str());
+  for(long i=0;i<p_fg->n_var;i++){
+    fout_text << p_fg->variables[i].id << " " << best_assignment[i] << std::endl;
+  }
+  fout_text.close();
+
+  std::string filename_energy = output_folder + "/map_result.out.energy";
+  std::cout << "DUMPING... ENERGY  : " << filename_energy << std::endl;
+  std::ofstream fout_energy(filename_energy.c_str());
+  fout_energy << std::setprecision(17) << -best_log_potential << std::endl;
+  fout_energy.close();
+}
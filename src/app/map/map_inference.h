@@ -0,0 +1,67 @@
+#include <iostream>
+#include <vector>
+#include "io/cmd_parser.h"
+#include "dstruct/factor_graph/factor_graph.h"
+#include "app/gibbs/gibbs_sampling.h"
+#include "common.h"
+
+#ifndef _MAP_INFERENCE_H_
+#define _MAP_INFERENCE_H_
+
+namespace dd{
+
+  /**
+   * Class for MAP inference (the most likely assignment) by simulated
+   * annealing with the gibbs samplers.
+   *
+   * Every factor graph copy of gibbs anneals independently from
+   * start_temperature down to end_temperature, geometrically over the
+   * epochs, with FactorGraph::inverse_temperature. The best assignment any
+   * copy reaches is then improved by greedy sweeps (ICM) until no variable
+   * changes. Assignments are compared by FactorGraph::log_potential().
+   */
+  class MapInference{
+  public:
+    // factor graph
+    FactorGraph * const p_fg;
+
+    // gibbs sampling, with its factor graph copies
+    GibbsSampling * const gibbs;
+
+    double start_temperature;
+    double end_temperature;
+
+    // the variables sampled in inference
+    std::vector<long> vids;
+
+    // best assignment so far, and its log potential
+    std::vector<VariableValue> best_assignment;
+    double best_log_potential;
+
+    MapInference(FactorGraph * const _p_fg, GibbsSampling * const _gibbs,
+      double start_temperature, double end_temperature);
+
+    /**
+     * Anneals for n_epoch epochs, then improves the best assignment by ICM
+     * and leaves it in the evid assignment of p_fg
+     */
+    void anneal(const int & n_epoch, const bool is_quiet);
+
+    /**
+     * Sets each variable of vids to its most likely value given the others,
+     * one after another, until none changes or max_sweeps sweeps. Returns
+     * the number of sweeps.
+     */
+    int icm(FactorGraph & fg, int max_sweeps);
+
+    /**
+     * Dumps the assignment of all variables, and its energy (the negative
+     * log potential, up to a constant)
+     */
+    void dump(const bool is_quiet);
+
+  };
+
+}
+
+#endif
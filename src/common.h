@@ -28,6 +28,8 @@
 #endif
 
 #include <math.h>
+#include <sys/resource.h>
+#include <stdio.h>
 
 #define LOG_2   0.693147180559945
 #define MINUS_LOG_THRESHOLD   -18.42
@@ -70,5 +72,48 @@ inline double average(double * array, int length) {
     return sum/length;
 }
 
+/**
+ * Resets the peak resident set size that peak_rss_bytes() returns to the
+ * current one, by writing 5 to /proc/self/clear_refs. Returns false where
+ * that is not supported, and the peak stays the one of the whole process.
+ */
+inline bool reset_peak_rss() {
+#ifdef __MACH__
+    return false;
+#else
+    FILE * f = fopen("/proc/self/clear_refs", "w");
+    if (f == NULL) return false;
+    bool is_reset = fputs("5", f) >= 0;
+    is_reset = fclose(f) == 0 && is_reset;
+    return is_reset;
+#endif
+}
+
+/**
+ * Returns the peak resident set size since the last reset_peak_rss(), or of
+ * the process so far, in bytes
+ */
+inline long peak_rss_bytes() {
+#ifndef __MACH__
+    // VmHWM follows reset_peak_rss(), ru_maxrss does not
+    FILE * f = fopen("/proc/self/status", "r");
+    if (f != NULL) {
+        char line[256];
+        long kb = -1;
+        while (fgets(line, sizeof(line), f)) {
+            if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) break;
+        }
+        fclose(f);
+        if (kb >= 0) return kb * 1024L;
+    }
+#endif
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __MACH__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * 1024L;
+#endif
+}
 
 #endif
\ No newline at end of file
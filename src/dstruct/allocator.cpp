@@ -0,0 +1,234 @@
+#include "dstruct/allocator.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#ifndef __MACH__
+#include <sched.h>
+#include <sys/mman.h>
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#endif
+
+#define SIZE_2MB (2L << 20)
+#define SIZE_1GB (1L << 30)
+
+namespace dd{
+
+  /**
+   * A live allocation made by alloc_raw()
+   */
+  struct Allocation {
+    void * p;
+    size_t nbytes;        // requested size
+    size_t mapped_bytes;  // size of the mapping, for munmap
+    int policy;           // policy actually used
+    std::string name;
+  };
+
+  static int alloc_policy = ALLOC_DEFAULT;
+  static bool alloc_prefault = false;
+  static std::mutex allocations_mutex;
+  static std::vector<Allocation> allocations;
+
+  bool parse_alloc_policy(const std::string & name, int & policy){
+    if(name == "none" || name == ""){
+      policy = ALLOC_DEFAULT;
+    }else if(name == "thp"){
+      policy = ALLOC_THP;
+    }else if(name == "2m"){
+      policy = ALLOC_HUGE_2MB;
+    }else if(name == "1g"){
+      policy = ALLOC_HUGE_1GB;
+    }else{
+      return false;
+    }
+    return true;
+  }
+
+  void set_alloc_policy(int policy, bool prefault){
+    alloc_policy = policy;
+    alloc_prefault = prefault;
+  }
+
+  // touch one byte per page of [p, p+nbytes) from threads running on the
+  // NUMA node of the caller, so pages are faulted in there and in parallel
+  static void prefault(void * p, size_t nbytes){
+    int node = 0;
+#ifndef __MACH__
+    int cpu = sched_getcpu();
+    if(cpu >= 0) node = numa_node_of_cpu(cpu);
+    if(node < 0) node = 0;
+#endif
+    long nthread = sysconf(_SC_NPROCESSORS_CONF) / (numa_max_node() + 1);
+    if(nthread < 1) nthread = 1;
+    const size_t page = 4096;
+    const size_t chunk = ((nbytes / nthread) / page + 1) * page;
+    std::vector<std::thread> threads;
+    for(long i=0;i<nthread;i++){
+      char * start = (char *) p + i * chunk;
+      char * end = std::min((char *) p + nbytes, start + chunk);
+      if(start >= end) break;
+      threads.push_back(std::thread([=]() {
+        numa_run_on_node(node);
+        for(volatile char * c = start; c < end; c += page){
+          *c = 0;
+        }
+      }));
+    }
+    for(size_t i=0;i<threads.size();i++){
+      threads[i].join();
+    }
+  }
+
+  void * alloc_raw(size_t nbytes, const char * name){
+    Allocation a;
+    a.p = NULL;
+    a.nbytes = nbytes;
+    a.mapped_bytes = 0;
+    // arrays smaller than a huge page are not worth one
+    a.policy = nbytes >= SIZE_2MB ? alloc_policy : ALLOC_DEFAULT;
+    a.name = name;
+
+#ifndef __MACH__
+    if(a.policy == ALLOC_HUGE_2MB || a.policy == ALLOC_HUGE_1GB){
+      size_t pagesize = a.policy == ALLOC_HUGE_2MB ? SIZE_2MB : SIZE_1GB;
+      int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+        (a.policy == ALLOC_HUGE_2MB ? MAP_HUGE_2MB : MAP_HUGE_1GB);
+      a.mapped_bytes = (nbytes + pagesize - 1) / pagesize * pagesize;
+      a.p = mmap(NULL, a.mapped_bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+      if(a.p == MAP_FAILED){
+        // not enough reserved huge pages, fall back to transparent huge pages
+        std::cout << "[WARNING] MAP_HUGETLB failed for " << name
+                  << ", falling back to transparent huge pages" << std::endl;
+        a.p = NULL;
+        a.mapped_bytes = 0;
+        a.policy = ALLOC_THP;
+      }
+    }
+    if(a.policy == ALLOC_THP){
+      if(posix_memalign(&a.p, SIZE_2MB, nbytes) != 0){
+        a.p = NULL;
+      }else{
+        madvise(a.p, nbytes, MADV_HUGEPAGE);
+      }
+    }
+#else
+    a.policy = ALLOC_DEFAULT;
+#endif
+    if(a.p == NULL){
+      a.policy = ALLOC_DEFAULT;
+      a.p = malloc(nbytes);
+    }
+    if(a.p == NULL){
+      std::cerr << "[ERROR] Out of memory allocating " << name << std::endl;
+      exit(1);
+    }
+
+    if(alloc_prefault){
+      prefault(a.p, nbytes);
+    }
+
+    std::lock_guard<std::mutex> lock(allocations_mutex);
+    allocations.push_back(a);
+    return a.p;
+  }
+
+  void free_raw(void * p){
+    if(p == NULL) return;
+    Allocation a;
+    {
+      std::lock_guard<std::mutex> lock(allocations_mutex);
+      for(size_t i=0;i<allocations.size();i++){
+        if(allocations[i].p == p){
+          a = allocations[i];
+          allocations.erase(allocations.begin() + i);
+          break;
+        }
+      }
+    }
+#ifndef __MACH__
+    if(a.mapped_bytes > 0){
+      munmap(p, a.mapped_bytes);
+      return;
+    }
+#endif
+    free(p);
+  }
+
+  int get_alloc_policy(const void * p){
+    std::lock_guard<std::mutex> lock(allocations_mutex);
+    for(size_t i=0;i<allocations.size();i++){
+      if(allocations[i].p == p) return allocations[i].policy;
+    }
+    return -1;
+  }
+
+  // returns the AnonHugePages bytes of the VMAs, per /proc/self/smaps, that
+  // overlap any of the given allocations, counting each VMA once
+  static size_t thp_backed_bytes(const std::vector<const Allocation *> & thp){
+    size_t backed = 0;
+#ifndef __MACH__
+    if(thp.empty()) return 0;
+    FILE * f = fopen("/proc/self/smaps", "r");
+    if(f == NULL) return 0;
+    unsigned long vma_begin, vma_end;
+    bool overlaps = false;
+    char line[512];
+    while(fgets(line, sizeof(line), f)){
+      size_t kb;
+      if(sscanf(line, "%lx-%lx", &vma_begin, &vma_end) == 2 && strchr(line, ' ') > strchr(line, '-')){
+        overlaps = false;
+        for(size_t i=0;i<thp.size() && !overlaps;i++){
+          const unsigned long begin = (unsigned long) thp[i]->p;
+          overlaps = vma_begin < begin + thp[i]->nbytes && begin < vma_end;
+        }
+      }else if(overlaps && sscanf(line, "AnonHugePages: %zu kB", &kb) == 1){
+        backed += kb * 1024;
+      }
+    }
+    fclose(f);
+#endif
+    return backed;
+  }
+
+  void print_alloc_report(std::ostream & out){
+    static const char * policy_names[] = {"none", "thp", "2m", "1g"};
+    std::lock_guard<std::mutex> lock(allocations_mutex);
+    size_t total = 0, total_explicit = 0, total_thp = 0;
+    std::vector<const Allocation *> thp;
+    out << "HUGE PAGE ALLOCATION REPORT:" << std::endl;
+    for(size_t i=0;i<allocations.size();i++){
+      const Allocation & a = allocations[i];
+      total += a.nbytes;
+      if(a.policy == ALLOC_HUGE_2MB || a.policy == ALLOC_HUGE_1GB){
+        total_explicit += a.nbytes;
+      }else if(a.policy == ALLOC_THP){
+        total_thp += a.nbytes;
+        thp.push_back(&a);
+      }
+      out << "   " << a.name << " [" << policy_names[a.policy] << "] "
+          << a.nbytes << " bytes" << std::endl;
+    }
+    out << "   TOTAL " << total << " bytes, " << total_explicit 
+        << " in explicit huge pages, " << total_thp << " in thp arrays" << std::endl;
+    if(!thp.empty()){
+      out << "   THP-BACKED BYTES OF THE VMAS HOLDING THP ARRAYS (MAY INCLUDE OTHER DATA): "
+          << thp_backed_bytes(thp) << std::endl;
+    }
+  }
+
+}
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <string>
+#include <new>
+
+#ifndef _ALLOCATOR_H_
+#define _ALLOCATOR_H_
+
+namespace dd{
+
+  // enumeration for allocation policies of the large factor graph arrays
+  enum ALLOC_POLICY{
+    ALLOC_DEFAULT  = 0,   // plain new[]
+    ALLOC_THP      = 1,   // transparent huge pages, madvise(MADV_HUGEPAGE)
+    ALLOC_HUGE_2MB = 2,   // explicit 2MB huge pages, mmap(MAP_HUGETLB)
+    ALLOC_HUGE_1GB = 3    // explicit 1GB huge pages, mmap(MAP_HUGETLB)
+  };
+
+  /**
+   * Parses a policy name (none, thp, 2m, 1g). Returns false if unknown.
+   */
+  bool parse_alloc_policy(const std::string & name, int & policy);
+
+  /**
+   * Sets the policy used by alloc_array() from now on, for arrays of at least
+   * one 2MB page (smaller arrays always use malloc). If prefault is set,
+   * arrays are touched in parallel by threads on the NUMA node of the caller
+   * right after allocation.
+   */
+  void set_alloc_policy(int policy, bool prefault);
+
+  /**
+   * Allocates nbytes under the current policy, and records it under name
+   * for print_alloc_report()
+   */
+  void * alloc_raw(size_t nbytes, const char * name);
+
+  /**
+   * Frees memory returned by alloc_raw()
+   */
+  void free_raw(void * p);
+
+  /**
+   * Allocates an array of n objects of type T under the current policy
+   */
+  template<class T>
+  T * alloc_array(long n, const char * name){
+    T * p = (T *) alloc_raw(sizeof(T) * (n > 0 ? n : 1), name);
+    for(long i=0;i<n;i++){
+      new (p + i) T;
+    }
+    return p;
+  }
+
+  /**
+   * Frees an array returned by alloc_array()
+   */
+  template<class T>
+  void free_array(T * p){
+    free_raw((void *) p);
+  }
+
+  /**
+   * Returns the policy a live allocation of alloc_raw() actually got, which
+   * falls back from explicit to transparent huge pages to none, or -1 if p
+   * is not one
+   */
+  int get_alloc_policy(const void * p);
+
+  /**
+   * Prints each live allocation with its size and policy. Explicit huge
+   * pages back the whole array. Transparent huge pages are only known per
+   * VMA (from /proc/self/smaps, read once), and a VMA may hold several
+   * arrays and other data, so they are reported as one total over the VMAs
+   * that hold thp arrays.
+   */
+  void print_alloc_report(std::ostream & out);
+
+}
+
+#endif
@@ -0,0 +1,29 @@
+#include "dstruct/factor_graph/bit_assignment.h"
+
+dd::BitAssignment::BitAssignment(long _nvars):
+  nvars(_nvars),
+  nwords((_nvars + 63) / 64),
+  words(new uint64_t[(_nvars + 63) / 64]),
+  is_shared(true) {
+  for(long i=0;i<nwords;i++){
+    words[i] = 0;
+  }
+}
+
+void dd::BitAssignment::pack(const VariableValue * const values){
+  for(long i=0;i<nwords;i++){
+    uint64_t word = 0;
+    for(long j=i*64;j<nvars && j<(i+1)*64;j++){
+      if(values[j]){
+        word |= ((uint64_t)1) << (j & 63);
+      }
+    }
+    words[i] = word;
+  }
+}
+
+void dd::BitAssignment::unpack(VariableValue * const values) const{
+  for(long i=0;i<nvars;i++){
+    values[i] = (*this)[i];
+  }
+}
@@ -0,0 +1,68 @@
+#include <stdint.h>
+#include "dstruct/factor_graph/variable.h"
+
+#ifndef _BIT_ASSIGNMENT_H_
+#define _BIT_ASSIGNMENT_H_
+
+namespace dd{
+
+  /**
+   * Assignment to Boolean variables packed one bit per variable.
+   *
+   * Reading with operator[] gives the value as a VariableValue, so the factor
+   * functions (see factor.hxx) evaluate a BitAssignment exactly like a plain
+   * VariableValue array, with a 32x smaller working set.
+   */
+  class BitAssignment {
+  public:
+
+    long nvars;     // number of variables
+    long nwords;    // number of 64-bit words
+    uint64_t * const words;
+
+    // whether set() must be atomic, because threads may write variables of
+    // the same word; cleared when each word has a single writer, see
+    // VariableSchedule::is_word_aligned()
+    bool is_shared;
+
+    BitAssignment(long _nvars);
+
+    /**
+     * Returns the value of variable vid
+     */
+    inline VariableValue operator[](const long & vid) const {
+      return (VariableValue)((words[vid >> 6] >> (vid & 63)) & 1);
+    }
+
+    /**
+     * Sets the value of variable vid. Unchanged bits are not written, and
+     * the write is atomic only if is_shared.
+     */
+    inline void set(const long & vid, const VariableValue & value) {
+      const uint64_t mask = ((uint64_t)1) << (vid & 63);
+      uint64_t & word = words[vid >> 6];
+      if(((word & mask) != 0) == (value != 0)) return;
+      if(!is_shared){
+        word ^= mask;
+      }else if(value){
+        __sync_fetch_and_or(&word, mask);
+      }else{
+        __sync_fetch_and_and(&word, ~mask);
+      }
+    }
+
+    /**
+     * Packs the given 0/1 assignment array
+     */
+    void pack(const VariableValue * const values);
+
+    /**
+     * Unpacks into the given assignment array
+     */
+    void unpack(VariableValue * const values) const;
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,11 @@
+#include "dstruct/factor_graph/chain_assignment.h"
+#include "dstruct/allocator.h"
+
+dd::ChainAssignment::ChainAssignment(long _nvars, int _nchains):
+  nvars(_nvars),
+  nchains(_nchains),
+  values(alloc_array<VariableValue>(_nvars * _nchains, "chain_assignments")) {
+  for(long i=0;i<nvars*nchains;i++){
+    values[i] = 0;
+  }
+}
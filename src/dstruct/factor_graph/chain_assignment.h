@@ -0,0 +1,61 @@
+#include "dstruct/factor_graph/variable.h"
+
+#ifndef _CHAIN_ASSIGNMENT_H_
+#define _CHAIN_ASSIGNMENT_H_
+
+namespace dd{
+
+  /**
+   * Assignments of nchains independent chains, stored chain-minor: the
+   * values of a variable in all chains are adjacent, so one traversal of a
+   * variable's factors loads the values of its neighbours for all chains
+   * from the same cache lines.
+   */
+  class ChainAssignment {
+  public:
+
+    long nvars;     // number of variables
+    int nchains;    // number of chains
+    VariableValue * const values;
+
+    ChainAssignment(long _nvars, int _nchains);
+
+    /**
+     * Returns the value of variable vid in the given chain
+     */
+    inline VariableValue get(const long & vid, const int & chain) const {
+      return values[vid * nchains + chain];
+    }
+
+    /**
+     * Sets the value of variable vid in the given chain
+     */
+    inline void set(const long & vid, const int & chain, const VariableValue & value) {
+      values[vid * nchains + chain] = value;
+    }
+
+  };
+
+  /**
+   * One chain of a ChainAssignment. Reading with operator[] gives the value
+   * in that chain, so the factor functions (see factor.hxx) evaluate it like
+   * a plain VariableValue array.
+   */
+  class ChainView {
+  public:
+
+    const ChainAssignment & assignment;
+    const int chain;
+
+    ChainView(const ChainAssignment & _assignment, int _chain) :
+      assignment(_assignment), chain(_chain) {}
+
+    inline VariableValue operator[](const long & vid) const {
+      return assignment.get(vid, chain);
+    }
+
+  };
+
+}
+
+#endif
@@ -9,7 +9,7 @@ namespace dd{
       id = _id;
     }
 
-    Factor::Factor(){
+    Factor::Factor() : multiplicity(1) {
 
     }
 
@@ -21,6 +21,7 @@ namespace dd{
       this->weight_id = _weight_id;
       this->func_id = _func_id;
       this->n_variables = _n_variables;
+      this->multiplicity = 1;
     }
  
 }
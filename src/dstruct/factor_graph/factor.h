@@ -4,6 +4,7 @@
 #include <assert.h>
 #include "dstruct/factor_graph/variable.h"
 #include "dstruct/factor_graph/weight.h"
+#include "dstruct/factor_graph/bit_assignment.h"
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
@@ -54,78 +55,89 @@ namespace dd{
     /**
      * Returns the potential of continousLR factor function. See factor.hxx for more detail
      */
+    template<class VALUES>
     inline double _potential_continuousLR(const VariableInFactor * const vifs,
-                                   const VariableValue * const var_values, 
+                                   const VALUES & var_values, 
                                    const VariableIndex &, const VariableValue &) const;
 
     /**
      * Returns the potential of or factor function. See factor.hxx for more detail
      */
+    template<class VALUES>
     inline double _potential_or(const VariableInFactor * const vifs,
-                                   const VariableValue * const var_values, 
+                                   const VALUES & var_values, 
                                    const VariableIndex &, const VariableValue &) const;
 
     /**
      * Returns the potential of and factor function. See factor.hxx for more detail
      */
+    template<class VALUES>
     inline double _potential_and(const VariableInFactor * const vifs,
-                                   const VariableValue * const var_values, 
+                                   const VALUES & var_values, 
                                    const VariableIndex &, const VariableValue &) const;
 
     /**
      * Returns the potential of equal factor function. See factor.hxx for more detail
      */
+    template<class VALUES>
     inline double _potential_equal(const VariableInFactor * const vifs,
-                                   const VariableValue * const var_values, 
+                                   const VALUES & var_values, 
                                    const VariableIndex &, const VariableValue &) const;
 
     /**
      * Returns the potential of MLN style imply factor function. See factor.hxx for more detail
      */
+    template<class VALUES>
     inline double _potential_imply_mln(const VariableInFactor * const vifs,
-                                   const VariableValue * const var_values, 
+                                   const VALUES & var_values, 
                                    const VariableIndex &, const VariableValue &) const;
 
     /**
      * Returns the potential of imply factor function. See factor.hxx for more detail
      */
+    template<class VALUES>
     inline double _potential_imply(const VariableInFactor * const vifs,
-                                   const VariableValue * const var_values, 
+                                   const VALUES & var_values, 
                                    const VariableIndex &, const VariableValue &) const;
     
     /**
      * Returns the potential of multinomial factor function. See factor.hxx for more detail
      */
+    template<class VALUES>
     inline double _potential_multinomial(const VariableInFactor * const vifs,
-                                   const VariableValue * const var_values, 
+                                   const VALUES & var_values, 
                                    const VariableIndex &, const VariableValue &) const;
 
     /**
      * Returns the potential of oneIsTrue factor function. See factor.hxx for more detail
      */
+    template<class VALUES>
     inline double _potential_oneistrue(const VariableInFactor * const vifs,
-                                       const VariableValue * const var_values,
+                                       const VALUES & var_values,
                                        const VariableIndex &, const VariableValue &) const;
 
     /**
      * Returns the potential of linear factor function. See factor.hxx for more detail
      */
+    template<class VALUES>
     inline double _potential_linear(const VariableInFactor * const vifs,
-                                   const VariableValue * const var_values, 
+                                   const VALUES & var_values, 
                                    const VariableIndex &, const VariableValue &) const;
 
     /**
      * Returns the potential of ratio factor function. See factor.hxx for more detail
      */
+    template<class VALUES>
     inline double _potential_ratio(const VariableInFactor * const vifs,
-                                   const VariableValue * const var_values, 
+                                   const VALUES & var_values, 
                                    const VariableIndex &, const VariableValue &) const;
 
     /**
      * Returns the potential of logical factor function. See factor.hxx for more detail
      */
+    template<class VALUES>
     inline double _potential_logical(const VariableInFactor * const vifs,
-                                   const VariableValue * const var_values, 
+                                   const VALUES & var_values, 
                                    const VariableIndex &, const VariableValue &) const;
 
 
@@ -136,15 +148,17 @@ namespace dd{
      * var_values for other variables in the factor
      *
      * vifs pointer to variables in the factor graph
-     * var_values pointer to variable values (array)
+     * var_values variable values, indexed by variable id (an array, or a
+     *            BitAssignment)
      * vid variable id to be calculated with proposal
      * proposal the proposed value
      *
      * This function is defined in the head to make sure
      * it gets inlined
      */
+    template<class VALUES>
     inline double potential(const VariableInFactor * const vifs,
-      const VariableValue * const var_values,
+      const VALUES & var_values,
       const VariableIndex & vid, const VariableValue & proposal) const{
       switch (func_id) {
         case FUNC_IMPLY_MLN   :return _potential_imply_mln(vifs, var_values, vid, proposal);
@@ -169,8 +183,9 @@ namespace dd{
 
 
   private:
+    template<class VALUES>
     inline bool is_variable_satisfied(const VariableInFactor& vif, const VariableIndex& vid, 
-      const VariableValue * const var_values, const VariableValue & proposal) const;
+      const VALUES & var_values, const VariableValue & proposal) const;
 
   };
 
@@ -185,6 +200,8 @@ namespace dd{
     int n_variables;        // number of variables
 
     long n_start_i_vif;     // start variable id
+    int multiplicity;       // number of identical factors merged into this one,
+                            // 0 if merged into another one
 
     std::vector<VariableInFactor> tmp_variables; // variables in the factor
 
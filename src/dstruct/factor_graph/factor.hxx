@@ -1,10 +1,11 @@
 namespace dd{
 
 	// whether a variable's value or proposal satisfies the is_equal condition
+	template<class VALUES>
 	inline bool dd::CompactFactor::is_variable_satisfied(
 		const VariableInFactor& vif,
 		const VariableIndex& vid, 
-		const VariableValue * const var_values,
+		const VALUES & var_values,
 		const VariableValue & proposal) const {
 
 		return (vif.vid == vid) ? vif.satisfiedUsing(proposal) : 
@@ -16,9 +17,10 @@ namespace dd{
 	 * the 'proposal' argument.
 	 *
 	 */
+	template<class VALUES>
 	inline double dd::CompactFactor::_potential_equal(
 	  const VariableInFactor * const vifs,
-	  const VariableValue * const var_values,
+	  const VALUES & var_values,
 	  const VariableIndex & vid, const VariableValue & proposal) const{
 
 	  const VariableInFactor & vif = vifs[n_start_i_vif];
@@ -40,9 +42,10 @@ namespace dd{
 	 * 'proposal' argument.
 	 *
 	 */
+	template<class VALUES>
 	inline double dd::CompactFactor::_potential_and(
 	  const VariableInFactor * const vifs,
-	  const VariableValue * const var_values,
+	  const VALUES & var_values,
 	  const VariableIndex & vid,
 	  const VariableValue & proposal) const{
 
@@ -62,9 +65,10 @@ namespace dd{
 	 * 'proposal' argument.
 	 *
 	 */
+	template<class VALUES>
 	inline double dd::CompactFactor::_potential_or(
 	  const VariableInFactor * const vifs,
-	  const VariableValue * const var_values,
+	  const VALUES & var_values,
 	  const VariableIndex & vid,
 	  const VariableValue & proposal) const{
 
@@ -91,9 +95,10 @@ namespace dd{
 	 * return 1.0 if the body is not satisfied.
 	 *
 	 */
+	template<class VALUES>
 	inline double dd::CompactFactor::_potential_imply_mln(
 	  const VariableInFactor * const vifs,
-	  const VariableValue * const var_values,
+	  const VALUES & var_values,
 	  const VariableIndex & vid,
 	  const VariableValue & proposal) const{
 
@@ -129,9 +134,10 @@ namespace dd{
 	 *  return 0.0 if the body is not satisfied.
 	 *
 	 */
+	template<class VALUES>
 	inline double dd::CompactFactor::_potential_imply(
 	  const VariableInFactor * const vifs,
-	  const VariableValue * const var_values,
+	  const VALUES & var_values,
 	  const VariableIndex & vid,
 	  const VariableValue & proposal) const{
 
@@ -156,8 +162,9 @@ namespace dd{
 	}
 
 	// potential for multinomial variable
+	template<class VALUES>
 	inline double dd::CompactFactor::_potential_multinomial(const VariableInFactor * vifs,
-	  const VariableValue * var_values, const VariableIndex & vid, const VariableValue & proposal) const {
+	  const VALUES & var_values, const VariableIndex & vid, const VariableValue & proposal) const {
 
 	  return 1.0;
 	}
@@ -167,9 +174,10 @@ namespace dd{
 	 * 'proposal' argument.
 	 *
 	 */
+	template<class VALUES>
 	inline double dd::CompactFactor::_potential_oneistrue(
 	  const VariableInFactor * const vifs,
-	  const VariableValue * const var_values,
+	  const VALUES & var_values,
 	  const VariableIndex & vid,
 	  const VariableValue & proposal) const{
 
@@ -190,9 +198,10 @@ namespace dd{
 	}
 
 	// potential for linear expression
+	template<class VALUES>
 	inline double dd::CompactFactor::_potential_linear(
 	  const VariableInFactor * const vifs,
-	  const VariableValue * const var_values,
+	  const VALUES & var_values,
 	  const VariableIndex & vid,
 	  const VariableValue & proposal) const{
 
@@ -209,9 +218,10 @@ namespace dd{
 	}
 
 	// potential for linear expression
+	template<class VALUES>
 	inline double dd::CompactFactor::_potential_ratio(
 	  const VariableInFactor * const vifs,
-	  const VariableValue * const var_values,
+	  const VALUES & var_values,
 	  const VariableIndex & vid,
 	  const VariableValue & proposal) const{
 
@@ -228,9 +238,10 @@ namespace dd{
 	}
 
 	// potential for linear expression
+	template<class VALUES>
 	inline double dd::CompactFactor::_potential_logical(
 	  const VariableInFactor * const vifs,
-	  const VariableValue * const var_values,
+	  const VALUES & var_values,
 	  const VariableIndex & vid,
 	  const VariableValue & proposal) const{
 
@@ -1,8 +1,10 @@
 
 #include <iostream>
+#include <iomanip>
 #include "io/binary_parser.h"
 #include "dstruct/factor_graph/factor_graph.h"
 #include "dstruct/factor_graph/factor.h"
+#include "dstruct/allocator.h"
 
 bool dd::FactorGraph::is_usable(){
   return this->sorted && this->safety_check_passed;
@@ -14,24 +16,88 @@ dd::FactorGraph::FactorGraph(long _n_var, long _n_factor, long _n_weight, long _
   variables(new Variable[_n_var]),
   factors(new Factor[_n_factor]),
   weights(new Weight[_n_weight]),
-  compact_factors(new CompactFactor[_n_edge]),
-  compact_factors_weightids(new int[_n_edge]),
-  factor_ids(new long[_n_edge]),
-  vifs(new VariableInFactor[_n_edge]),
+  compact_factors(alloc_array<CompactFactor>(_n_edge, "compact_factors")),
+  compact_factors_weightids(alloc_array<int>(_n_edge, "compact_factors_weightids")),
+  factor_ids(alloc_array<long>(_n_edge, "factor_ids")),
+  vifs(alloc_array<VariableInFactor>(_n_edge, "vifs")),
+  dedupe_factors(false), n_merged(0), compact_factors_multiplicities(NULL),
+  n_inf_edge(0), n_inf_vif(0),
+  inf_compact_factors(NULL), inf_compact_factors_weightids(NULL), 
+  inf_compact_factors_multiplicities(NULL), inf_vifs(NULL),
+  inf_n_start_i_factors(NULL), inf_n_factors(NULL), inference_view_active(false),
+  fold_unary(false), n_unary(0), unary_start(NULL), unary_weightids(NULL),
+  unary_vifs(NULL), unary_bias(NULL),
+  hot_weight_threshold(0), n_hot_weights(0), hot_weight_slots(NULL), hot_weight_ids(NULL),
+  prefetch_distance(0), inverse_temperature(1.0),
   infrs(new InferenceResult(_n_var, _n_weight)),
   sorted(false),
   safety_check_passed(false) {}
 
 void dd::FactorGraph::copy_from(const FactorGraph * const p_other_fg){
   // copy each member from the given graph
+  assert(p_other_fg->inference_view_active == false);
   memcpy(variables, p_other_fg->variables, sizeof(Variable)*n_var);
-  memcpy(factors, p_other_fg->factors, sizeof(Factor)*n_factor);
-  memcpy(weights, p_other_fg->weights, sizeof(Weight)*n_weight);
-  memcpy(factor_ids, p_other_fg->factor_ids, sizeof(long)*n_edge);
   memcpy(vifs, p_other_fg->vifs, sizeof(VariableInFactor)*n_edge);
+  if(p_other_fg->factors == NULL){
+    // the source is finalized, so is the copy
+    this->release_load_only();
+  }else{
+    memcpy(factors, p_other_fg->factors, sizeof(Factor)*n_factor);
+    memcpy(weights, p_other_fg->weights, sizeof(Weight)*n_weight);
+    memcpy(factor_ids, p_other_fg->factor_ids, sizeof(long)*n_edge);
+  }
 
   memcpy(compact_factors, p_other_fg->compact_factors, sizeof(CompactFactor)*n_edge);
   memcpy(compact_factors_weightids, p_other_fg->compact_factors_weightids, sizeof(int)*n_edge);
+  dedupe_factors = p_other_fg->dedupe_factors;
+  n_merged = p_other_fg->n_merged;
+  if(p_other_fg->compact_factors_multiplicities != NULL){
+    compact_factors_multiplicities = alloc_array<int>(n_edge, "compact_factors_multiplicities");
+    memcpy(compact_factors_multiplicities, p_other_fg->compact_factors_multiplicities, sizeof(int)*n_edge);
+  }
+
+  if(p_other_fg->inf_compact_factors != NULL){
+    n_inf_edge = p_other_fg->n_inf_edge;
+    n_inf_vif = p_other_fg->n_inf_vif;
+    inf_compact_factors = alloc_array<CompactFactor>(n_inf_edge, "inf_compact_factors");
+    inf_compact_factors_weightids = alloc_array<int>(n_inf_edge, "inf_compact_factors_weightids");
+    inf_vifs = alloc_array<VariableInFactor>(n_inf_vif, "inf_vifs");
+    inf_n_start_i_factors = alloc_array<long>(n_var, "inf_n_start_i_factors");
+    inf_n_factors = alloc_array<int>(n_var, "inf_n_factors");
+    memcpy(inf_compact_factors, p_other_fg->inf_compact_factors, sizeof(CompactFactor)*n_inf_edge);
+    memcpy(inf_compact_factors_weightids, p_other_fg->inf_compact_factors_weightids, sizeof(int)*n_inf_edge);
+    memcpy(inf_vifs, p_other_fg->inf_vifs, sizeof(VariableInFactor)*n_inf_vif);
+    memcpy(inf_n_start_i_factors, p_other_fg->inf_n_start_i_factors, sizeof(long)*n_var);
+    memcpy(inf_n_factors, p_other_fg->inf_n_factors, sizeof(int)*n_var);
+    if(p_other_fg->inf_compact_factors_multiplicities != NULL){
+      inf_compact_factors_multiplicities = alloc_array<int>(n_inf_edge, "inf_compact_factors_multiplicities");
+      memcpy(inf_compact_factors_multiplicities, p_other_fg->inf_compact_factors_multiplicities, sizeof(int)*n_inf_edge);
+    }
+  }
+
+  fold_unary = p_other_fg->fold_unary;
+  if(p_other_fg->unary_bias != NULL){
+    n_unary = p_other_fg->n_unary;
+    unary_start = alloc_array<long>(n_var+1, "unary_start");
+    unary_weightids = alloc_array<int>(n_unary, "unary_weightids");
+    unary_vifs = alloc_array<VariableInFactor>(n_unary, "unary_vifs");
+    unary_bias = alloc_array<double>(2*n_var, "unary_bias");
+    memcpy(unary_start, p_other_fg->unary_start, sizeof(long)*(n_var+1));
+    memcpy(unary_weightids, p_other_fg->unary_weightids, sizeof(int)*n_unary);
+    memcpy(unary_vifs, p_other_fg->unary_vifs, sizeof(VariableInFactor)*n_unary);
+    memcpy(unary_bias, p_other_fg->unary_bias, sizeof(double)*2*n_var);
+  }
+
+  prefetch_distance = p_other_fg->prefetch_distance;
+  inverse_temperature = p_other_fg->inverse_temperature;
+  hot_weight_threshold = p_other_fg->hot_weight_threshold;
+  if(p_other_fg->hot_weight_slots != NULL){
+    n_hot_weights = p_other_fg->n_hot_weights;
+    hot_weight_slots = alloc_array<int>(n_weight, "hot_weight_slots");
+    hot_weight_ids = alloc_array<long>(n_hot_weights, "hot_weight_ids");
+    memcpy(hot_weight_slots, p_other_fg->hot_weight_slots, sizeof(int)*n_weight);
+    memcpy(hot_weight_ids, p_other_fg->hot_weight_ids, sizeof(long)*n_hot_weights);
+  }
 
   c_nvar = p_other_fg->c_nvar;
   c_nfactor = p_other_fg->c_nfactor;
@@ -40,9 +106,23 @@ void dd::FactorGraph::copy_from(const FactorGraph * const p_other_fg){
   sorted = p_other_fg->sorted;
   safety_check_passed = p_other_fg->safety_check_passed;
 
-  infrs->init(variables, weights);
+  infrs->init(variables, NULL);
+  memcpy(infrs->weight_values, p_other_fg->infrs->weight_values, sizeof(double)*n_weight);
+  memcpy(infrs->weights_isfixed, p_other_fg->infrs->weights_isfixed, sizeof(bool)*n_weight);
+  memcpy(infrs->assignments_free, p_other_fg->infrs->assignments_free, sizeof(VariableValue)*n_var);
+  memcpy(infrs->assignments_evid, p_other_fg->infrs->assignments_evid, sizeof(VariableValue)*n_var);
+  if(p_other_fg->infrs->assignments_free_bits != NULL){
+    infrs->enable_bitpacking();
+  }
   infrs->ntallies = p_other_fg->infrs->ntallies;
-  infrs->multinomial_tallies = new int[p_other_fg->infrs->ntallies];
+  infrs->rao_blackwell = p_other_fg->infrs->rao_blackwell;
+  if(p_other_fg->infrs->scan_uncertainty != NULL){
+    infrs->enable_adaptive_scan(p_other_fg->infrs->scan_threshold, p_other_fg->infrs->scan_min_prob);
+  }
+  if(p_other_fg->infrs->chains != NULL){
+    infrs->enable_chains(p_other_fg->infrs->chains->nchains);
+  }
+  infrs->multinomial_tallies = new double[p_other_fg->infrs->ntallies];
   for(long i=0;i<infrs->ntallies;i++){
     infrs->multinomial_tallies[i] = p_other_fg->infrs->multinomial_tallies[i];
   }
@@ -70,12 +150,66 @@ long dd::FactorGraph::get_multinomial_weight_id(const VariableValue *assignments
 }
 
 
+void dd::FactorGraph::update_unary_weight(const Variable & variable, HotGradients * const hot){
+  if (unary_bias != NULL && variable.domain_type == DTYPE_BOOLEAN) {
+    const VariableValue value_evid = infrs->is_packed ? 
+      (*infrs->assignments_evid_bits)[variable.id] : infrs->assignments_evid[variable.id];
+    const VariableValue value_free = infrs->is_packed ? 
+      (*infrs->assignments_free_bits)[variable.id] : infrs->assignments_free[variable.id];
+    for(long i=unary_start[variable.id];i<unary_start[variable.id+1];i++){
+      if(infrs->weights_isfixed[unary_weightids[i]] == false){
+        add_gradient(unary_weightids[i],
+          unary_vifs[i].satisfiedUsing(value_evid) - unary_vifs[i].satisfiedUsing(value_free), hot);
+      }
+    }
+  }
+}
+
+void dd::FactorGraph::update_weight(const Variable & variable, const FactorValues & evid,
+  const FactorValues & free, HotGradients * const hot){
+  update_unary_weight(variable, hot);
+
+  const int n_values = evid.n_values;
+  const int k_evid = (int)(infrs->is_packed ? (*infrs->assignments_evid_bits)[variable.id] : 
+    infrs->assignments_evid[variable.id]) - variable.lower_bound;
+  const int k_free = (int)(infrs->is_packed ? (*infrs->assignments_free_bits)[variable.id] : 
+    infrs->assignments_free[variable.id]) - variable.lower_bound;
+  for(long i=0;i<variable.n_factors;i++){
+    const long e = i*n_values + k_evid;
+    const long f = i*n_values + k_free;
+    // same gradients as update_weight(variable) below; for Boolean variables
+    // both weight ids are the same
+    const long wid1 = evid.wids[e];
+    const long wid2 = free.wids[f];
+    if (variable.domain_type == DTYPE_BOOLEAN) {
+      if(infrs->weights_isfixed[wid1] == false){
+        add_gradient(wid1, evid.values[e] - free.values[f], hot);
+      }
+    } else {
+      const int equal = (wid1 == wid2);
+      if(infrs->weights_isfixed[wid1] == false){
+        add_gradient(wid1, evid.values[e] - equal * free.values[f], hot);
+      }
+      if(infrs->weights_isfixed[wid2] == false){
+        add_gradient(wid2, equal * evid.values[e] - free.values[f], hot);
+      }
+    }
+  }
+}
+
 void dd::FactorGraph::update_weight(const Variable & variable){
+  // folded unary factors, same gradient as the Boolean case below
+  update_unary_weight(variable, NULL);
+
   // corresponding factors and weights in a continous region
   CompactFactor * const fs = compact_factors + variable.n_start_i_factors;
   const int * const ws = compact_factors_weightids + variable.n_start_i_factors;
+  const int * const ms = compact_factors_multiplicities == NULL ? NULL :
+    compact_factors_multiplicities + variable.n_start_i_factors;
   // for each factor
   for(long i=0;i<variable.n_factors;i++){
+    // a merged factor counts once per duplicate
+    const double m = ms == NULL ? 1 : ms[i];
     // boolean variable
     if (variable.domain_type == DTYPE_BOOLEAN) {
       // only update weight when it is not fixed
@@ -85,8 +219,8 @@ void dd::FactorGraph::update_weight(const Variable & variable){
         // gradient of weight = E[f|D] - E[f], where D is evidence variables, 
         // f is the factor function, E[] is expectation. Expectation is calculated
         // using a sample of the variable.
-        infrs->weight_values[ws[i]] += 
-          stepsize * (this->template potential<false>(fs[i]) - this->template potential<true>(fs[i]));
+        infrs->apply_gradient(ws[i], stepsize,
+          m * (this->template potential<false>(fs[i]) - this->template potential<true>(fs[i])));
       }
     } else if (variable.domain_type == DTYPE_MULTINOMIAL) {
       // two weights need to be updated
@@ -99,16 +233,72 @@ void dd::FactorGraph::update_weight(const Variable & variable){
       int equal = (wid1 == wid2);
 
       if(infrs->weights_isfixed[wid1] == false){
-        infrs->weight_values[wid1] += 
-          stepsize * (this->template potential<false>(fs[i]) - equal * this->template potential<true>(fs[i]));
+        infrs->apply_gradient(wid1, stepsize,
+          m * (this->template potential<false>(fs[i]) - equal * this->template potential<true>(fs[i])));
       }
 
       if(infrs->weights_isfixed[wid2] == false){
-        infrs->weight_values[wid2] += 
-          stepsize * (equal * this->template potential<false>(fs[i]) - this->template potential<true>(fs[i]));
+        infrs->apply_gradient(wid2, stepsize,
+          m * (equal * this->template potential<false>(fs[i]) - this->template potential<true>(fs[i])));
+      }
+    }
+  }
+}
+
+double dd::FactorGraph::neg_ps_loglikelihood(const std::vector<long> & vids){
+  double neg_ps_ll = 0.0;
+  for(size_t k=0;k<vids.size();k++){
+    const Variable & variable = variables[vids[k]];
+    const VariableValue value = infrs->is_packed ? 
+      (*infrs->assignments_evid_bits)[variable.id] : infrs->assignments_evid[variable.id];
+    // log of the sum of exp(potential) over the domain, stably
+    std::vector<double> log_potentials;
+    double max_log_potential = -INFINITY;
+    for(int propose=variable.lower_bound;propose<=variable.upper_bound;propose++){
+      log_potentials.push_back(this->template potential<false>(variable, propose));
+      max_log_potential = std::max(max_log_potential, log_potentials.back());
+    }
+    double sum = 0.0;
+    for(size_t i=0;i<log_potentials.size();i++){
+      sum += exp(log_potentials[i] - max_log_potential);
+    }
+    neg_ps_ll += max_log_potential + log(sum) - 
+      log_potentials[(int)value - variable.lower_bound];
+  }
+  return neg_ps_ll;
+}
+
+double dd::FactorGraph::log_potential(const std::vector<long> & vids){
+  std::vector<bool> in_vids(n_var, false);
+  for(size_t k=0;k<vids.size();k++){
+    in_vids[vids[k]] = true;
+  }
+  double log_pot = 0.0;
+  for(size_t k=0;k<vids.size();k++){
+    const Variable & variable = variables[vids[k]];
+    const VariableValue value = infrs->is_packed ? 
+      (*infrs->assignments_evid_bits)[variable.id] : infrs->assignments_evid[variable.id];
+    // a factor is counted by the variable of vids in it with the lowest id
+    std::vector<bool> is_counted(variable.n_factors, true);
+    for(long i=0;i<variable.n_factors;i++){
+      const CompactFactor & factor = compact_factors[variable.n_start_i_factors + i];
+      for(long j=factor.n_start_i_vif;j<factor.n_start_i_vif+factor.n_variables;j++){
+        if(vifs[j].vid < variable.id && in_vids[vifs[j].vid]){
+          is_counted[i] = false;
+          break;
+        }
+      }
+    }
+    // the first factor comes with the folded unary factors, if any
+    log_pot += this->template potential<false>(variable, value, 0, 
+      variable.n_factors > 0 && is_counted[0] ? 1 : 0);
+    for(long i=1;i<variable.n_factors;i++){
+      if(is_counted[i]){
+        log_pot += this->template potential<false>(variable, value, i, i+1);
       }
     }
   }
+  return log_pot;
 }
 
 void dd::FactorGraph::load(const CmdParser & cmd, const bool is_quiet){
@@ -160,11 +350,66 @@ void dd::FactorGraph::load(const CmdParser & cmd, const bool is_quiet){
   }
 
   // construct edge-based store
+  infrs->rao_blackwell = cmd.rao_blackwell->getValue();
+  if (cmd.adaptive_scan->getValue() > 0) {
+    infrs->enable_adaptive_scan(cmd.adaptive_scan->getValue(), cmd.adaptive_scan_min->getValue());
+  }
+  this->fold_unary = cmd.fold_unary->getValue();
+  this->dedupe_factors = cmd.dedupe_factors->getValue();
+  this->hot_weight_threshold = cmd.hot_weight_threshold->getValue();
+  this->prefetch_distance = cmd.prefetch_distance->getValue();
   this->organize_graph_by_edge();
+  if (hot_weight_threshold > 0) {
+    this->find_hot_weights();
+    if (!is_quiet) {
+      std::cout << "HOT WEIGHTS: #" << n_hot_weights << std::endl;
+    }
+  }
+  if (dedupe_factors && !is_quiet) {
+    std::cout << "MERGED DUPLICATE FACTORS: #" << n_merged << std::endl;
+  }
+  if (fold_unary && !is_quiet) {
+    std::cout << "FOLDED UNARY FACTORS: #" << n_unary << std::endl;
+  }
   this->safety_check();
 
   assert(this->is_usable() == true);
 
+  bool is_boolean_only = true;
+  for(long i=0;i<n_var;i++){
+    if(variables[i].domain_type != DTYPE_BOOLEAN){
+      is_boolean_only = false;
+      break;
+    }
+  }
+
+  // several chains per thread for Boolean-only graphs, which the chains
+  // keep their own assignments for
+  const int n_chains = cmd.n_chains->getValue();
+  if (n_chains > 1) {
+    if (!is_boolean_only) {
+      std::cout << "[WARNING] --n_chains needs a Boolean-only graph, ignoring it" << std::endl;
+    } else if (infrs->scan_uncertainty != NULL) {
+      std::cout << "[WARNING] --n_chains is not supported with --adaptive_scan, ignoring it" << std::endl;
+    } else {
+      infrs->enable_chains(n_chains);
+      if (!is_quiet) {
+        std::cout << "CHAINS PER THREAD: " << n_chains << std::endl;
+      }
+    }
+  }
+
+  // bit-pack the assignments of Boolean-only graphs
+  if (cmd.boolean_bitpack->getValue()) {
+    if (is_boolean_only) {
+      infrs->enable_bitpacking();
+    }
+    if (!is_quiet) {
+      std::cout << "BOOLEAN BITPACK: " << (is_boolean_only ? "ENABLED" : 
+        "DISABLED (graph has non-Boolean variables)") << std::endl;
+    }
+  }
+
 }
 
 // sort according to id
@@ -204,28 +449,422 @@ void dd::FactorGraph::organize_graph_by_edge() {
     }
   }
 
+  // count the factors each variable connects to
+  for(long i=0;i<n_var;i++){
+    variables[i].n_factors = 0;
+  }
+  if(dedupe_factors){
+    merge_duplicate_factors();
+  }
+  for(long i=0;i<n_factor;i++){
+    if(is_folded(factors[i]) || factors[i].multiplicity == 0) continue;
+    for(const VariableInFactor & vif : factors[i].tmp_variables){
+      variables[vif.vid].n_factors ++;
+    }
+  }
+
   c_edge = 0;
   long ntallies = 0;
-  // for each variable, put the factors into factor_dups
+  // for each variable, reserve a continuous region for its factors
   for(long i=0;i<n_var;i++){
     Variable & variable = variables[i];
-    variable.n_factors = variable.tmp_factor_ids.size();  // no edge count any more
-    
     variable.n_start_i_factors = c_edge;
     if(variable.domain_type == DTYPE_MULTINOMIAL){
       variable.n_start_i_tally = ntallies;
       ntallies += variable.upper_bound - variable.lower_bound + 1;
     }
-    for(const long & fid : variable.tmp_factor_ids){
-      factor_ids[c_edge] = fid;
-      compact_factors[c_edge].id = factors[fid].id;
-      compact_factors[c_edge].func_id = factors[fid].func_id;
-      compact_factors[c_edge].n_variables = factors[fid].n_variables;
-      compact_factors[c_edge].n_start_i_vif = factors[fid].n_start_i_vif;
-      compact_factors_weightids[c_edge] = factors[fid].weight_id;
-      c_edge ++;
+    c_edge += variable.n_factors;
+    variable.n_factors = 0;
+  }
+
+  if(dedupe_factors){
+    compact_factors_multiplicities = alloc_array<int>(n_edge, "compact_factors_multiplicities");
+  }
+
+  // put the factors into the region of each variable they connect to,
+  // in the order of factor id
+  for(long fid=0;fid<n_factor;fid++){
+    const Factor & factor = factors[fid];
+    if(is_folded(factor) || factor.multiplicity == 0) continue;
+    for(const VariableInFactor & vif : factor.tmp_variables){
+      Variable & variable = variables[vif.vid];
+      long i_edge = variable.n_start_i_factors + variable.n_factors;
+      factor_ids[i_edge] = fid;
+      compact_factors[i_edge].id = factor.id;
+      compact_factors[i_edge].func_id = factor.func_id;
+      compact_factors[i_edge].n_variables = factor.n_variables;
+      compact_factors[i_edge].n_start_i_vif = factor.n_start_i_vif;
+      compact_factors_weightids[i_edge] = factor.weight_id;
+      if(compact_factors_multiplicities != NULL){
+        compact_factors_multiplicities[i_edge] = factor.multiplicity;
+      }
+      variable.n_factors ++;
     }
   }
+
+  if(!fold_unary) return;
+
+  // put the folded unary factors into the side region of their variable
+  unary_start = alloc_array<long>(n_var+1, "unary_start");
+  for(long i=0;i<=n_var;i++){
+    unary_start[i] = 0;
+  }
+  for(long fid=0;fid<n_factor;fid++){
+    if(is_folded(factors[fid])) unary_start[factors[fid].tmp_variables[0].vid + 1] ++;
+  }
+  for(long i=0;i<n_var;i++){
+    unary_start[i+1] += unary_start[i];
+  }
+  n_unary = unary_start[n_var];
+  unary_weightids = alloc_array<int>(n_unary, "unary_weightids");
+  unary_vifs = alloc_array<VariableInFactor>(n_unary, "unary_vifs");
+  std::vector<long> n_filled(n_var, 0);
+  for(long fid=0;fid<n_factor;fid++){
+    const Factor & factor = factors[fid];
+    if(!is_folded(factor)) continue;
+    const long vid = factor.tmp_variables[0].vid;
+    const long i = unary_start[vid] + n_filled[vid] ++;
+    unary_weightids[i] = factor.weight_id;
+    unary_vifs[i] = factor.tmp_variables[0];
+  }
+  unary_bias = alloc_array<double>(2*n_var, "unary_bias");
+  update_unary_bias();
+}
+
+void dd::FactorGraph::find_hot_weights(){
+  // each factor counts once, at the edge of its first variable
+  std::vector<long> n_factors_of(n_weight, 0);
+  for(long v=0;v<n_var;v++){
+    const Variable & variable = variables[v];
+    for(long i=variable.n_start_i_factors;i<variable.n_start_i_factors+variable.n_factors;i++){
+      if(vifs[compact_factors[i].n_start_i_vif].vid == variable.id){
+        n_factors_of[compact_factors_weightids[i]] ++;
+      }
+    }
+  }
+
+  // folded unary factors count towards their weight too
+  for(long i=0;i<n_unary;i++){
+    n_factors_of[unary_weightids[i]] ++;
+  }
+
+  n_hot_weights = 0;
+  hot_weight_slots = alloc_array<int>(n_weight, "hot_weight_slots");
+  for(long i=0;i<n_weight;i++){
+    hot_weight_slots[i] = n_factors_of[i] >= hot_weight_threshold ? n_hot_weights ++ : -1;
+  }
+  hot_weight_ids = alloc_array<long>(n_hot_weights, "hot_weight_ids");
+  for(long i=0;i<n_weight;i++){
+    if(hot_weight_slots[i] >= 0) hot_weight_ids[hot_weight_slots[i]] = i;
+  }
+}
+
+void dd::FactorGraph::init_hot_gradients(HotGradients & hot){
+  hot.grads.assign(n_hot_weights, 0.0);
+  hot.n_pending = 0;
+}
+
+void dd::FactorGraph::flush_hot_gradients(HotGradients & hot){
+  for(long i=0;i<n_hot_weights;i++){
+    if(hot.grads[i] != 0){
+      if(infrs->weights_isfixed[hot_weight_ids[i]] == false){
+        infrs->apply_gradient(hot_weight_ids[i], stepsize, hot.grads[i]);
+      }
+      hot.grads[i] = 0;
+    }
+  }
+  hot.n_pending = 0;
+}
+
+// orders factors by function, weight, and variables, then by id
+class factor_content_sorter {
+public:
+  const dd::Factor * factors;
+  factor_content_sorter(const dd::Factor * _factors) : factors(_factors) {}
+  // compares the content of two factors, <0, 0, >0 as in strcmp
+  int compare(const dd::Factor & a, const dd::Factor & b) const {
+    if(a.func_id != b.func_id) return a.func_id < b.func_id ? -1 : 1;
+    if(a.weight_id != b.weight_id) return a.weight_id < b.weight_id ? -1 : 1;
+    if(a.tmp_variables.size() != b.tmp_variables.size()) 
+      return a.tmp_variables.size() < b.tmp_variables.size() ? -1 : 1;
+    for(size_t i=0;i<a.tmp_variables.size();i++){
+      const dd::VariableInFactor & x = a.tmp_variables[i], & y = b.tmp_variables[i];
+      if(x.vid != y.vid) return x.vid < y.vid ? -1 : 1;
+      if(x.n_position != y.n_position) return x.n_position < y.n_position ? -1 : 1;
+      if(x.is_positive != y.is_positive) return x.is_positive < y.is_positive ? -1 : 1;
+      if(x.equal_to != y.equal_to) return x.equal_to < y.equal_to ? -1 : 1;
+    }
+    return 0;
+  }
+  inline bool operator()(const long & left, const long & right) const {
+    int c = compare(factors[left], factors[right]);
+    return c != 0 ? c < 0 : left < right;
+  }
+};
+
+void dd::FactorGraph::merge_duplicate_factors(){
+  factor_content_sorter sorter(factors);
+  std::vector<long> fids;
+  for(long fid=0;fid<n_factor;fid++){
+    factors[fid].multiplicity = 1;
+    if(!is_folded(factors[fid])) fids.push_back(fid);
+  }
+  std::sort(fids.begin(), fids.end(), sorter);
+
+  // each run of identical factors starts with its lowest id
+  n_merged = 0;
+  for(size_t i=0;i<fids.size();){
+    size_t j = i + 1;
+    while(j < fids.size() && sorter.compare(factors[fids[i]], factors[fids[j]]) == 0){
+      factors[fids[j]].multiplicity = 0;
+      j ++;
+    }
+    factors[fids[i]].multiplicity = j - i;
+    n_merged += j - i - 1;
+    i = j;
+  }
+}
+
+bool dd::FactorGraph::is_folded(const Factor & factor) const{
+  return fold_unary && factor.tmp_variables.size() == 1 &&
+    (factor.func_id == FUNC_AND || factor.func_id == FUNC_ISTRUE || factor.func_id == FUNC_OR) &&
+    variables[factor.tmp_variables[0].vid].domain_type == DTYPE_BOOLEAN;
+}
+
+void dd::FactorGraph::update_unary_bias(){
+  if(unary_bias == NULL) return;
+  for(long vid=0;vid<n_var;vid++){
+    double bias_neg = 0.0, bias_pos = 0.0;
+    for(long i=unary_start[vid];i<unary_start[vid+1];i++){
+      const double weight = infrs->weight_values[unary_weightids[i]];
+      bias_neg += weight * unary_vifs[i].satisfiedUsing(0);
+      bias_pos += weight * unary_vifs[i].satisfiedUsing(1);
+    }
+    unary_bias[2*vid] = bias_neg;
+    unary_bias[2*vid+1] = bias_pos;
+  }
+}
+
+void dd::FactorGraph::build_inference_view(bool sample_evidence, const bool is_quiet){
+  // whether a variable keeps its value during inference
+  std::vector<bool> is_fixed(n_var);
+  for(long i=0;i<n_var;i++){
+    const Variable & variable = variables[i];
+    is_fixed[i] = variable.is_observation || (variable.is_evid && !sample_evidence);
+  }
+
+  // simplify each factor into kept_factors, with its variables in kept_vifs
+  std::vector<CompactFactor> kept_factors;
+  std::vector<int> kept_weightids;
+  std::vector<int> kept_multiplicities;
+  std::vector<VariableInFactor> kept_vifs;
+  long n_dropped = 0, n_reduced = 0;
+  for(long fid=0;fid<n_factor;fid++){
+    const Factor & factor = factors[fid];
+    // merged into another factor, see dedupe_factors
+    if(factor.multiplicity == 0) continue;
+    long n_free = 0, n_sat = 0, n_unsat = 0;
+    for(const VariableInFactor & vif : factor.tmp_variables){
+      if(!is_fixed[vif.vid]){
+        n_free ++;
+      }else if(vif.satisfiedUsing(infrs->assignments_evid[vif.vid])){
+        n_sat ++;
+      }else{
+        n_unsat ++;
+      }
+    }
+    if(n_free == 0){
+      n_dropped ++;
+      continue;
+    }
+    // already in the unary bias, see fold_unary
+    if(is_folded(factor)) continue;
+
+    CompactFactor cf(factor.id);
+    cf.func_id = factor.func_id;
+    cf.n_start_i_vif = kept_vifs.size();
+    bool is_partial = n_sat + n_unsat > 0;
+    bool negate = false;
+    switch(factor.func_id){
+      case FUNC_AND:
+      case FUNC_ISTRUE:
+        if(n_unsat > 0){ n_dropped ++; continue; }
+        break;
+      case FUNC_OR:
+        if(n_sat > 0){ n_dropped ++; continue; }
+        break;
+      case FUNC_EQUAL:
+        if(n_sat > 0 && n_unsat > 0){ n_dropped ++; continue; }
+        if(is_partial){
+          cf.func_id = FUNC_AND;
+          negate = n_unsat > 0;
+        }
+        break;
+      default:
+        is_partial = false;
+    }
+
+    for(const VariableInFactor & vif : factor.tmp_variables){
+      if(is_partial && is_fixed[vif.vid]) continue;
+      kept_vifs.push_back(vif);
+      if(negate){
+        kept_vifs.back().is_positive = !vif.is_positive;
+      }
+    }
+    cf.n_variables = kept_vifs.size() - cf.n_start_i_vif;
+    if(is_partial) n_reduced ++;
+    kept_factors.push_back(cf);
+    kept_weightids.push_back(factor.weight_id);
+    kept_multiplicities.push_back(factor.multiplicity);
+  }
+
+  // count the kept factors of each free variable, and reserve its region
+  inf_n_start_i_factors = alloc_array<long>(n_var, "inf_n_start_i_factors");
+  inf_n_factors = alloc_array<int>(n_var, "inf_n_factors");
+  for(long i=0;i<n_var;i++){
+    inf_n_factors[i] = 0;
+  }
+  for(const CompactFactor & cf : kept_factors){
+    for(long i=cf.n_start_i_vif;i<cf.n_start_i_vif+cf.n_variables;i++){
+      if(!is_fixed[kept_vifs[i].vid]) inf_n_factors[kept_vifs[i].vid] ++;
+    }
+  }
+  n_inf_edge = 0;
+  for(long i=0;i<n_var;i++){
+    inf_n_start_i_factors[i] = n_inf_edge;
+    n_inf_edge += inf_n_factors[i];
+    inf_n_factors[i] = 0;
+  }
+
+  // fill the regions, in the order of factor id as in organize_graph_by_edge()
+  n_inf_vif = kept_vifs.size();
+  inf_compact_factors = alloc_array<CompactFactor>(n_inf_edge, "inf_compact_factors");
+  inf_compact_factors_weightids = alloc_array<int>(n_inf_edge, "inf_compact_factors_weightids");
+  inf_vifs = alloc_array<VariableInFactor>(n_inf_vif, "inf_vifs");
+  if(compact_factors_multiplicities != NULL){
+    inf_compact_factors_multiplicities = alloc_array<int>(n_inf_edge, "inf_compact_factors_multiplicities");
+  }
+  std::copy(kept_vifs.begin(), kept_vifs.end(), inf_vifs);
+  for(size_t k=0;k<kept_factors.size();k++){
+    const CompactFactor & cf = kept_factors[k];
+    for(long i=cf.n_start_i_vif;i<cf.n_start_i_vif+cf.n_variables;i++){
+      long vid = kept_vifs[i].vid;
+      if(is_fixed[vid]) continue;
+      long i_edge = inf_n_start_i_factors[vid] + inf_n_factors[vid];
+      inf_compact_factors[i_edge] = cf;
+      inf_compact_factors_weightids[i_edge] = kept_weightids[k];
+      if(inf_compact_factors_multiplicities != NULL){
+        inf_compact_factors_multiplicities[i_edge] = kept_multiplicities[k];
+      }
+      inf_n_factors[vid] ++;
+    }
+  }
+
+  if (!is_quiet) {
+    std::cout << "INFERENCE VIEW: #" << n_inf_edge << " EDGES (OF " << n_edge << "), "
+              << n_dropped << " CONSTANT FACTORS DROPPED, " << n_reduced 
+              << " FACTORS PARTIALLY EVALUATED" << std::endl;
+  }
+}
+
+void dd::FactorGraph::use_inference_view(bool active){
+  if(inf_compact_factors == NULL || inference_view_active == active) return;
+  std::swap(compact_factors, inf_compact_factors);
+  std::swap(compact_factors_weightids, inf_compact_factors_weightids);
+  std::swap(compact_factors_multiplicities, inf_compact_factors_multiplicities);
+  std::swap(vifs, inf_vifs);
+  for(long i=0;i<n_var;i++){
+    std::swap(variables[i].n_start_i_factors, inf_n_start_i_factors[i]);
+    std::swap(variables[i].n_factors, inf_n_factors[i]);
+  }
+  inference_view_active = active;
+}
+
+void dd::FactorGraph::release_load_only(){
+  // Factor holds a std::vector, so it needs delete[] to release it
+  delete [] factors;
+  delete [] weights;
+  free_array(factor_ids);
+  factors = NULL;
+  weights = NULL;
+  factor_ids = NULL;
+}
+
+long dd::FactorGraph::print_memory_usage(std::ostream & out, const std::string & title){
+  long total = 0;
+  out << "MEMORY USAGE (" << title << "):" << std::endl;
+  // prints one array and adds it to the total
+  #define PRINT_ARRAY_BYTES(name, bytes) \
+    { long b = (bytes); total += b; \
+      out << "   " << std::setw(26) << std::left << name << b << " bytes" << std::endl; }
+
+  PRINT_ARRAY_BYTES("variables", sizeof(Variable) * n_var);
+  if(factors != NULL){
+    long factor_bytes = sizeof(Factor) * n_factor;
+    for(long i=0;i<n_factor;i++){
+      factor_bytes += sizeof(VariableInFactor) * factors[i].tmp_variables.capacity();
+    }
+    PRINT_ARRAY_BYTES("factors", factor_bytes);
+    PRINT_ARRAY_BYTES("weights", sizeof(Weight) * n_weight);
+    PRINT_ARRAY_BYTES("factor_ids", sizeof(long) * n_edge);
+  }
+  PRINT_ARRAY_BYTES("compact_factors", sizeof(CompactFactor) * n_edge);
+  PRINT_ARRAY_BYTES("compact_factors_weightids", sizeof(int) * n_edge);
+  PRINT_ARRAY_BYTES("vifs", sizeof(VariableInFactor) * n_edge);
+  if(compact_factors_multiplicities != NULL){
+    PRINT_ARRAY_BYTES("compact_factors_multiplicities", sizeof(int) * n_edge);
+  }
+  if(inf_compact_factors != NULL){
+    PRINT_ARRAY_BYTES("inf_compact_factors", sizeof(CompactFactor) * n_inf_edge);
+    PRINT_ARRAY_BYTES("inf_compact_factors_weightids", sizeof(int) * n_inf_edge);
+    PRINT_ARRAY_BYTES("inf_vifs", sizeof(VariableInFactor) * n_inf_vif);
+    if(inf_compact_factors_multiplicities != NULL){
+      PRINT_ARRAY_BYTES("inf_compact_factors_multiplicities", sizeof(int) * n_inf_edge);
+    }
+    PRINT_ARRAY_BYTES("inf_n_start_i_factors", sizeof(long) * n_var);
+    PRINT_ARRAY_BYTES("inf_n_factors", sizeof(int) * n_var);
+  }
+  if(unary_bias != NULL){
+    PRINT_ARRAY_BYTES("unary_start", sizeof(long) * (n_var+1));
+    PRINT_ARRAY_BYTES("unary_weightids", sizeof(int) * n_unary);
+    PRINT_ARRAY_BYTES("unary_vifs", sizeof(VariableInFactor) * n_unary);
+    PRINT_ARRAY_BYTES("unary_bias", sizeof(double) * 2 * n_var);
+  }
+  if(hot_weight_slots != NULL){
+    PRINT_ARRAY_BYTES("hot_weight_slots", sizeof(int) * n_weight);
+    PRINT_ARRAY_BYTES("hot_weight_ids", sizeof(long) * n_hot_weights);
+  }
+  PRINT_ARRAY_BYTES("agg_means", sizeof(double) * n_var);
+  PRINT_ARRAY_BYTES("agg_nsamples", sizeof(double) * n_var);
+  PRINT_ARRAY_BYTES("assignments_free", sizeof(VariableValue) * n_var);
+  PRINT_ARRAY_BYTES("assignments_evid", sizeof(VariableValue) * n_var);
+  if(infrs->assignments_free_bits != NULL){
+    PRINT_ARRAY_BYTES("assignments_bits", 2 * sizeof(uint64_t) * infrs->assignments_free_bits->nwords);
+  }
+  PRINT_ARRAY_BYTES("multinomial_tallies", sizeof(double) * infrs->ntallies);
+  if(infrs->scan_uncertainty != NULL){
+    PRINT_ARRAY_BYTES("scan_uncertainty", sizeof(float) * n_var);
+  }
+  if(infrs->chains != NULL){
+    PRINT_ARRAY_BYTES("chain_assignments", sizeof(VariableValue) * n_var * infrs->chains->nchains);
+    PRINT_ARRAY_BYTES("chain_means", sizeof(double) * n_var * infrs->chains->nchains);
+  }
+  PRINT_ARRAY_BYTES("weight_values", sizeof(double) * n_weight);
+  PRINT_ARRAY_BYTES("weights_isfixed", sizeof(bool) * n_weight);
+  if(infrs->weight_m != NULL){
+    PRINT_ARRAY_BYTES("weight_m", sizeof(double) * n_weight);
+  }
+  if(infrs->weight_v != NULL){
+    PRINT_ARRAY_BYTES("weight_v", sizeof(double) * n_weight);
+  }
+  if(infrs->weight_beta1_t != NULL){
+    PRINT_ARRAY_BYTES("weight_beta1_t", sizeof(double) * n_weight);
+    PRINT_ARRAY_BYTES("weight_beta2_t", sizeof(double) * n_weight);
+  }
+  #undef PRINT_ARRAY_BYTES
+
+  out << "   TOTAL                     " << total << " bytes" << std::endl;
+  return total;
 }
 
 void dd::FactorGraph::safety_check(){
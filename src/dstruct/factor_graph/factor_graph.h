@@ -13,6 +13,36 @@
 #define _FACTOR_GRAPH_H_
 
 namespace dd{
+
+  /**
+   * Potentials of the factors of one variable for each of its values, in one
+   * assignment, captured while sampling the variable so that the gradient can
+   * be applied without evaluating the factors again. See
+   * FactorGraph::factor_values().
+   */
+  class FactorValues {
+  public:
+    int n_values;                   // domain size of the variable
+    std::vector<double> values;     // [i*n_values+k]: factor i, times its multiplicity,
+                                    // with the variable at lower_bound+k
+    std::vector<long> wids;         // [i*n_values+k]: weight id of the above
+    std::vector<double> potentials; // [k]: weighted sum of the above over the factors
+  };
+
+  /**
+   * Gradients of the hot weights (see FactorGraph::hot_weight_slots)
+   * accumulated by one thread, indexed by slot, until they are flushed
+   * into the weights with FactorGraph::flush_hot_gradients()
+   */
+  class HotGradients {
+  public:
+    std::vector<double> grads;
+    long n_pending;     // variables sampled since the last flush
+
+    // variables a thread samples between flushes
+    static const long flush_interval = 1024;
+  };
+
   /**
    * Class for a factor graph
    */
@@ -39,19 +69,78 @@ namespace dd{
     double stepsize;
 
     // variables, factors, weights
+    // factors and weights are only needed while loading, and are NULL after
+    // release_load_only()
     Variable * const variables;
-    Factor * const factors;
-    Weight * const weights;
+    Factor * factors;
+    Weight * weights;
 
     // For each edge, we store the factor, weight id, factor id, and the variable, 
     // in the same index of seperate arrays. The edges are ordered so that the
     // edges for a variable is in a continuous region (sequentially). 
     // This allows us to access factors given variables, and access variables
     // given factors faster. 
-    CompactFactor * const compact_factors;
-    int * const compact_factors_weightids;
-    long * const factor_ids;
-    VariableInFactor * const vifs;
+    // While inferring, compact_factors, compact_factors_weightids and vifs
+    // may be swapped with the inference view below, see use_inference_view().
+    CompactFactor * compact_factors;
+    int * compact_factors_weightids;
+    long * factor_ids;    // load only, NULL after release_load_only()
+    VariableInFactor * vifs;
+
+    // Duplicate factor merging, enabled by dedupe_factors before
+    // organize_graph_by_edge(). Factors with the same function, weight and
+    // variables are stored once, and the potential and the gradient of each
+    // edge are scaled by compact_factors_multiplicities. NULL if not merged.
+    bool dedupe_factors;
+    long n_merged;
+    int * compact_factors_multiplicities;
+
+    // Inference view of the edge-based store, with the same layout as above.
+    // Factors that are constant given the fixed variables (evidence and
+    // observations) are dropped, and fixed values are substituted into the
+    // others; see build_inference_view(). NULL if not built.
+    long n_inf_edge;
+    long n_inf_vif;
+    CompactFactor * inf_compact_factors;
+    int * inf_compact_factors_weightids;
+    int * inf_compact_factors_multiplicities;
+    VariableInFactor * inf_vifs;
+    long * inf_n_start_i_factors;   // per variable, as Variable::n_start_i_factors
+    int * inf_n_factors;            // per variable, as Variable::n_factors
+    bool inference_view_active;
+
+    // Unary factor folding, enabled by fold_unary before 
+    // organize_graph_by_edge(). Unary AND, ISTRUE and OR factors of Boolean
+    // variables are then left out of the edge-based store. The weights and
+    // vifs of those of variable vid are in [unary_start[vid], 
+    // unary_start[vid+1]) of unary_weightids and unary_vifs, and their
+    // weighted potential for value v is in unary_bias[2*vid+v], see 
+    // update_unary_bias(). NULL if not folded.
+    bool fold_unary;
+    long n_unary;
+    long * unary_start;
+    int * unary_weightids;
+    VariableInFactor * unary_vifs;
+    double * unary_bias;
+
+    // Hot weights, found by find_hot_weights() if hot_weight_threshold is
+    // positive. Weights with at least hot_weight_threshold factors, counting
+    // folded unary factors and, for multinomial factors, only their first
+    // weight, are hot: their learning gradients are accumulated per thread
+    // in the slot hot_weight_slots[wid] (-1 if not hot) of HotGradients, and
+    // applied every HotGradients::flush_interval variables. NULL if not found.
+    long hot_weight_threshold;
+    long n_hot_weights;
+    int * hot_weight_slots;
+    long * hot_weight_ids;    // weight id of each slot
+
+    // Software prefetching of the variables samplers visit next, see
+    // prefetch(). 0 disables it.
+    int prefetch_distance;
+
+    // potentials are multiplied by this, so that the replica samples at
+    // temperature 1/inverse_temperature, see --n_temperatures
+    double inverse_temperature;
 
     // pointer to inference result
     InferenceResult * const infrs ;
@@ -90,6 +179,92 @@ namespace dd{
      */
     void update_weight(const Variable & variable);
 
+    /**
+     * Same as update_weight(variable), but takes the factor potentials from
+     * the given values, captured by factor_values() for the evid and the
+     * free assignment after the variable was last changed in either. 
+     * Gradients of hot weights go to hot if it is not NULL.
+     */
+    void update_weight(const Variable & variable, const FactorValues & evid,
+      const FactorValues & free, HotGradients * const hot = NULL);
+
+    /**
+     * Fills fv with the potential of each factor of the given variable for
+     * each of its values, and their weighted sums, which are the same as
+     * potential<does_change_evid>(variable, value), in one pass over the
+     * factors.
+     */
+    template<bool does_change_evid>
+    inline void factor_values(const Variable & variable, FactorValues & fv);
+
+    /**
+     * Prefetches one stage of the data needed to sample the given variable:
+     * stage 0, its Variable; stage 1, its factor rows; stage 2, the variables
+     * in those factors (vifs); stage 3, the values of those variables in the
+     * evid assignment (or the chains), and in the free one if is_learning.
+     * Each stage only reads data the previous one prefetched, so samplers
+     * issue stage s for the variable (4-s)*prefetch_distance positions
+     * ahead. Only the first max_prefetch_factors factors are prefetched.
+     */
+    inline void prefetch(const long & vid, const int & stage, const bool & is_learning);
+
+    static const long max_prefetch_factors = 16;
+
+    /**
+     * Returns in pot_neg[c] and pot_pos[c] the log-linear weighted potential
+     * of all factors of the given Boolean variable for values 0 and 1 in
+     * chain c of infrs->chains, in one pass over the factors
+     */
+    inline void chain_potentials(const Variable & variable, double * const pot_neg,
+      double * const pot_pos);
+
+    /**
+     * Applies the gradient of the folded unary factors of the given variable
+     */
+    void update_unary_weight(const Variable & variable, HotGradients * const hot);
+
+    /**
+     * Applies gradient g to weight wid, or accumulates it in hot if the
+     * weight is hot and hot is not NULL
+     */
+    inline void add_gradient(const long & wid, const double & g, HotGradients * const hot){
+      if(hot != NULL && hot_weight_slots[wid] >= 0){
+        hot->grads[hot_weight_slots[wid]] += g;
+      }else{
+        infrs->apply_gradient(wid, stepsize, g);
+      }
+    }
+
+    /**
+     * Sizes hot for this graph's hot weights, with no pending gradients
+     */
+    void init_hot_gradients(HotGradients & hot);
+
+    /**
+     * Applies and clears the gradients accumulated in hot
+     */
+    void flush_hot_gradients(HotGradients & hot);
+
+    /**
+     * Counts the factors of each weight and finds the hot weights, see
+     * hot_weight_threshold. Called by load(), after organize_graph_by_edge().
+     */
+    void find_hot_weights();
+
+    /**
+     * Returns the negative pseudo-loglikelihood of the values of the given
+     * variables in the evid assignment, each conditioned on the rest of it
+     */
+    double neg_ps_loglikelihood(const std::vector<long> & vids);
+
+    /**
+     * Returns the log of the unnormalized probability of the evid assignment,
+     * tempered by inverse_temperature, up to a term that only depends on the
+     * variables not in vids: the weighted potential of each factor with a
+     * variable in vids, counted once, plus their folded unary factors
+     */
+    double log_potential(const std::vector<long> & vids);
+
     /**
      * Returns potential of the given factor
      *
@@ -98,6 +273,10 @@ namespace dd{
      */
     template<bool does_change_evid>
     inline double potential(const CompactFactor & factor){
+      if(infrs->is_packed){
+        return factor.potential(vifs, does_change_evid ? *infrs->assignments_free_bits :
+          *infrs->assignments_evid_bits, -1, -1);
+      }
       if(does_change_evid == true){
         return factor.potential(vifs, infrs->assignments_free, -1, -1);
       }else{
@@ -110,6 +289,12 @@ namespace dd{
 
     inline void update_evid(Variable & variable, const double & new_value);
 
+    inline void update_weighted(Variable & variable, const double & new_value,
+      const double & estimate, const double & sample_weight);
+
+    inline void update_rao_blackwell(Variable & variable, const double & new_value,
+      const std::vector<double> & log_potentials, const double & log_sum);
+
     /**
      * Returns log-linear weighted potential of the all factors for the given 
      * variable using the propsal value.
@@ -119,6 +304,18 @@ namespace dd{
      */
     template<bool does_change_evid>
     inline double potential(const Variable & variable, const double & proposal){
+      return potential<does_change_evid>(variable, proposal, 0, variable.n_factors);
+    }
+
+    /**
+     * Same as above, summed over the begin-th to (end-1)-th factors the
+     * variable connects to only. Folded unary factors count with begin = 0.
+     * Lets several threads sum the potential of a hub variable, see
+     * SingleNodeSampler::sample_hubs().
+     */
+    template<bool does_change_evid>
+    inline double potential(const Variable & variable, const double & proposal,
+      const long & begin, const long & end){
       // potential
       double pot = 0.0;  
       double tmp;
@@ -130,12 +327,29 @@ namespace dd{
       CompactFactor * const fs = &compact_factors[variable.n_start_i_factors];
       // the weights, corresponding to the factor with the same index
       const int * const ws = &compact_factors_weightids[variable.n_start_i_factors];   
+      // the multiplicities of merged duplicate factors, if any
+      const int * const ms = compact_factors_multiplicities == NULL ? NULL :
+        &compact_factors_multiplicities[variable.n_start_i_factors];
       
+      // folded unary factors
+      if (variable.domain_type == DTYPE_BOOLEAN && unary_bias != NULL && begin == 0) {
+        pot = unary_bias[2*variable.id + (int)proposal];
+      }
+
       // boolean type
-      if (variable.domain_type == DTYPE_BOOLEAN) {   
+      if (variable.domain_type == DTYPE_BOOLEAN && infrs->is_packed) {
+        // bit-packed assignment, see InferenceResult::pack_assignments()
+        const BitAssignment & bits = does_change_evid ? *infrs->assignments_free_bits :
+          *infrs->assignments_evid_bits;
+        for(long i=begin;i<end;i++){
+          tmp = fs[i].potential(vifs, bits, variable.id, proposal);
+          if (ms != NULL) tmp *= ms[i];
+          pot += infrs->weight_values[ws[i]] * tmp;
+        }
+      } else if (variable.domain_type == DTYPE_BOOLEAN) {   
         // for all factors that the variable connects to, calculate the 
         // weighted potential
-        for(long i=0;i<variable.n_factors;i++){
+        for(long i=begin;i<end;i++){
           if(does_change_evid == true){
             tmp = fs[i].potential(
                 vifs, infrs->assignments_free, variable.id, proposal);
@@ -143,10 +357,11 @@ namespace dd{
             tmp = fs[i].potential(
                 vifs, infrs->assignments_evid, variable.id, proposal);
           }
+          if (ms != NULL) tmp *= ms[i];
           pot += infrs->weight_values[ws[i]] * tmp;
         }
       } else if (variable.domain_type == DTYPE_MULTINOMIAL) { // multinomial
-        for (long i = 0; i < variable.n_factors; i++) {
+        for (long i = begin; i < end; i++) {
           if(does_change_evid == true) {
             tmp = fs[i].potential(vifs, infrs->assignments_free, variable.id, proposal);
             // get weight id associated with this factor and variable assignment
@@ -155,10 +370,11 @@ namespace dd{
             tmp = fs[i].potential(vifs, infrs->assignments_evid, variable.id, proposal);
             wid = get_multinomial_weight_id(infrs->assignments_evid, fs[i], variable.id, proposal);
           }
+          if (ms != NULL) tmp *= ms[i];
           pot += infrs->weight_values[wid] * tmp;
         }
       } // end if for variable type
-      return pot;
+      return pot * inverse_temperature;
     }
 
     /**
@@ -184,6 +400,61 @@ namespace dd{
      */
     void safety_check();
 
+    /**
+     * Finds factors with the same function, weight and variables (sorted by
+     * position), and merges each group into its lowest id factor, by setting
+     * Factor::multiplicity. Called by organize_graph_by_edge() if 
+     * dedupe_factors is set. Folded unary factors are not merged.
+     */
+    void merge_duplicate_factors();
+
+    /**
+     * Returns whether the given factor is folded into the unary bias of its
+     * variable, see fold_unary
+     */
+    bool is_folded(const Factor & factor) const;
+
+    /**
+     * Recomputes unary_bias from the current weights. Called whenever the
+     * weights change between sampling passes, e.g., after each learning epoch.
+     */
+    void update_unary_bias();
+
+    /**
+     * Builds the inference view of the edge-based store. Variables are fixed
+     * during inference if they are observations, or evidence when evidence is
+     * not sampled. Then
+     *  - factors over fixed variables only are constant, and are dropped;
+     *  - fixed variables are substituted into AND, ISTRUE, OR and EQUAL
+     *    factors: the factor is dropped if this makes it constant, and
+     *    otherwise keeps its free variables only (EQUAL becomes an AND over
+     *    the free variables, negated if the fixed ones are unsatisfied);
+     *  - other factors are kept as they are;
+     *  - fixed variables get no factors, as they are never sampled.
+     * Must be called after organize_graph_by_edge(), before 
+     * release_load_only(). The learning view is left untouched.
+     */
+    void build_inference_view(bool sample_evidence, const bool is_quiet);
+
+    /**
+     * Swaps the inference view in (active = true) or out. No-op if the
+     * inference view is not built or already in the given state.
+     */
+    void use_inference_view(bool active);
+
+    /**
+     * Frees the structures only needed while loading (factors with their
+     * variable lists, weights, and factor_ids), once the edge-based store
+     * has been constructed.
+     */
+    void release_load_only();
+
+    /**
+     * Prints the bytes used by each array of the factor graph and its
+     * inference result. Returns the total.
+     */
+    long print_memory_usage(std::ostream & out, const std::string & title);
+
     /**
      * Returns wether the factor graph is usable.
      * A factor graph is usable when gone through safety_check and sort_by_id()
@@ -197,14 +468,22 @@ namespace dd{
    */
   template<>
   inline void FactorGraph::update<true>(Variable & variable, const double & new_value){
-    infrs->assignments_free[variable.id] = new_value;
+    if(infrs->is_packed){
+      infrs->assignments_free_bits->set(variable.id, new_value);
+    }else{
+      infrs->assignments_free[variable.id] = new_value;
+    }
   }
 
   /**
    * Updates the evid assignments for the given variable useing new_value
    */
   inline void FactorGraph::update_evid(Variable & variable, const double & new_value){
-    infrs->assignments_evid[variable.id] = new_value;
+    if(infrs->is_packed){
+      infrs->assignments_evid_bits->set(variable.id, new_value);
+    }else{
+      infrs->assignments_evid[variable.id] = new_value;
+    }
   }
 
   /**
@@ -212,7 +491,7 @@ namespace dd{
    */
   template<>
   inline void FactorGraph::update<false>(Variable & variable, const double & new_value){
-    infrs->assignments_evid[variable.id] = new_value;
+    update_evid(variable, new_value);
     infrs->agg_means[variable.id] += new_value;
     infrs->agg_nsamples[variable.id]  ++ ;
     if(variable.domain_type == DTYPE_MULTINOMIAL){
@@ -220,6 +499,160 @@ namespace dd{
     }
   }
 
+  /**
+   * Updates the evid assignment of the given Boolean variable using new_value,
+   * for inference, and accumulates estimate with the given sample weight.
+   * estimate is new_value, or the conditional probability of 1 it was sampled
+   * with for the Rao-Blackwellized estimator. sample_weight is 1/q for
+   * variables visited with probability q by adaptive scan.
+   */
+  inline void FactorGraph::update_weighted(Variable & variable, const double & new_value,
+    const double & estimate, const double & sample_weight){
+    update_evid(variable, new_value);
+    infrs->agg_means[variable.id] += sample_weight * estimate;
+    infrs->agg_nsamples[variable.id] += sample_weight;
+  }
+
+  /**
+   * Updates the evid assignment of the given multinomial variable using 
+   * new_value, for inference, and accumulates the conditional distribution 
+   * the value was sampled with, given by the log potential of each value and
+   * their log sum
+   */
+  inline void FactorGraph::update_rao_blackwell(Variable & variable, const double & new_value,
+    const std::vector<double> & log_potentials, const double & log_sum){
+    update_evid(variable, new_value);
+    double mean = 0.0;
+    for(int value=variable.lower_bound;value<=variable.upper_bound;value++){
+      const double p = exp(log_potentials[value] - log_sum);
+      infrs->multinomial_tallies[variable.n_start_i_tally + value - variable.lower_bound] += p;
+      mean += p * value;
+    }
+    infrs->agg_means[variable.id] += mean;
+    infrs->agg_nsamples[variable.id] ++ ;
+  }
+
+  template<bool does_change_evid>
+  inline void FactorGraph::factor_values(const Variable & variable, FactorValues & fv){
+    const int n_values = variable.upper_bound - variable.lower_bound + 1;
+    const size_t n = (size_t)variable.n_factors * n_values;
+    fv.n_values = n_values;
+    if(fv.values.size() < n){
+      fv.values.resize(n);
+      fv.wids.resize(n);
+    }
+    fv.potentials.assign(n_values, 0.0);
+
+    // folded unary factors
+    if (variable.domain_type == DTYPE_BOOLEAN && unary_bias != NULL) {
+      fv.potentials[0] = unary_bias[2*variable.id];
+      fv.potentials[1] = unary_bias[2*variable.id + 1];
+    }
+
+    CompactFactor * const fs = &compact_factors[variable.n_start_i_factors];
+    const int * const ws = &compact_factors_weightids[variable.n_start_i_factors];   
+    const int * const ms = compact_factors_multiplicities == NULL ? NULL :
+      &compact_factors_multiplicities[variable.n_start_i_factors];
+    VariableValue * const assignments = does_change_evid ? 
+      infrs->assignments_free : infrs->assignments_evid;
+
+    for(long i=0;i<variable.n_factors;i++){
+      for(int k=0;k<n_values;k++){
+        const VariableValue proposal = variable.lower_bound + k;
+        double tmp;
+        long wid;
+        if (variable.domain_type == DTYPE_BOOLEAN) {
+          if (infrs->is_packed) {
+            tmp = fs[i].potential(vifs, does_change_evid ? *infrs->assignments_free_bits :
+              *infrs->assignments_evid_bits, variable.id, proposal);
+          } else {
+            tmp = fs[i].potential(vifs, assignments, variable.id, proposal);
+          }
+          wid = ws[i];
+        } else {
+          tmp = fs[i].potential(vifs, assignments, variable.id, proposal);
+          wid = get_multinomial_weight_id(assignments, fs[i], variable.id, proposal);
+        }
+        if (ms != NULL) tmp *= ms[i];
+        fv.values[i*n_values + k] = tmp;
+        fv.wids[i*n_values + k] = wid;
+        fv.potentials[k] += infrs->weight_values[wid] * tmp;
+      }
+    }
+  }
+
+  inline void FactorGraph::prefetch(const long & vid, const int & stage, const bool & is_learning){
+    if(stage == 0){
+      _mm_prefetch((const char *)&variables[vid], _MM_HINT_T0);
+      return;
+    }
+    const Variable & variable = variables[vid];
+    const long start = variable.n_start_i_factors;
+    const long n = variable.n_factors < max_prefetch_factors ? variable.n_factors : max_prefetch_factors;
+    if(stage == 1){
+      // one prefetch per cache line of 64 bytes
+      for(long i=0;i<n;i+=64/sizeof(CompactFactor)){
+        _mm_prefetch((const char *)&compact_factors[start+i], _MM_HINT_T0);
+      }
+      for(long i=0;i<n;i+=64/sizeof(int)){
+        _mm_prefetch((const char *)&compact_factors_weightids[start+i], _MM_HINT_T0);
+      }
+      if(unary_bias != NULL){
+        _mm_prefetch((const char *)&unary_bias[2*vid], _MM_HINT_T0);
+      }
+    }else if(stage == 2){
+      for(long i=0;i<n;i++){
+        _mm_prefetch((const char *)&vifs[compact_factors[start+i].n_start_i_vif], _MM_HINT_T0);
+      }
+    }else{
+      for(long i=0;i<n;i++){
+        const CompactFactor & factor = compact_factors[start+i];
+        for(long j=factor.n_start_i_vif;j<factor.n_start_i_vif+factor.n_variables;j++){
+          const long other = vifs[j].vid;
+          if(infrs->chains != NULL && !is_learning){
+            _mm_prefetch((const char *)&infrs->chains->values[other * infrs->chains->nchains], _MM_HINT_T0);
+          }else if(infrs->is_packed){
+            _mm_prefetch((const char *)&infrs->assignments_evid_bits->words[other >> 6], _MM_HINT_T0);
+            if(is_learning){
+              _mm_prefetch((const char *)&infrs->assignments_free_bits->words[other >> 6], _MM_HINT_T0);
+            }
+          }else{
+            _mm_prefetch((const char *)&infrs->assignments_evid[other], _MM_HINT_T0);
+            if(is_learning){
+              _mm_prefetch((const char *)&infrs->assignments_free[other], _MM_HINT_T0);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  inline void FactorGraph::chain_potentials(const Variable & variable, double * const pot_neg,
+    double * const pot_pos){
+    const ChainAssignment & chains = *infrs->chains;
+    const int n_chains = chains.nchains;
+
+    // folded unary factors
+    for(int c=0;c<n_chains;c++){
+      pot_neg[c] = unary_bias == NULL ? 0.0 : unary_bias[2*variable.id];
+      pot_pos[c] = unary_bias == NULL ? 0.0 : unary_bias[2*variable.id + 1];
+    }
+
+    CompactFactor * const fs = &compact_factors[variable.n_start_i_factors];
+    const int * const ws = &compact_factors_weightids[variable.n_start_i_factors];   
+    const int * const ms = compact_factors_multiplicities == NULL ? NULL :
+      &compact_factors_multiplicities[variable.n_start_i_factors];
+    for(long i=0;i<variable.n_factors;i++){
+      const double w = ms == NULL ? infrs->weight_values[ws[i]] : 
+        infrs->weight_values[ws[i]] * ms[i];
+      for(int c=0;c<n_chains;c++){
+        const ChainView view(chains, c);
+        pot_neg[c] += w * fs[i].potential(vifs, view, variable.id, 0);
+        pot_pos[c] += w * fs[i].potential(vifs, view, variable.id, 1);
+      }
+    }
+  }
+
   // sort variable in factor by their position
   bool compare_position(const VariableInFactor& x, const VariableInFactor& y);
 
@@ -1,22 +1,56 @@
 #include "dstruct/factor_graph/inference_result.h"
+#include "dstruct/allocator.h"
+#include <stdlib.h>
+#include <assert.h>
+#include <algorithm>
 
 dd::InferenceResult::InferenceResult(long _nvars, long _nweights):
   nvars(_nvars),
   nweights(_nweights),
-  agg_means(new double[_nvars]),
-  agg_nsamples(new double[_nvars]),
-  assignments_free(new VariableValue[_nvars]),
-  assignments_evid(new VariableValue[_nvars]),
-  weight_values(new double [_nweights]),
-  weights_isfixed(new bool [_nweights]) {}
+  agg_means(alloc_array<double>(_nvars, "agg_means")),
+  agg_nsamples(alloc_array<double>(_nvars, "agg_nsamples")),
+  assignments_free(alloc_array<VariableValue>(_nvars, "assignments_free")),
+  assignments_evid(alloc_array<VariableValue>(_nvars, "assignments_evid")),
+  weight_values(alloc_array<double>(_nweights, "weight_values")),
+  weights_isfixed(alloc_array<bool>(_nweights, "weights_isfixed")),
+  assignments_free_bits(NULL),
+  assignments_evid_bits(NULL),
+  is_packed(false),
+  rao_blackwell(false),
+  scan_uncertainty(NULL),
+  scan_threshold(0),
+  scan_min_prob(1),
+  n_visits(0),
+  chains(NULL),
+  chain_means(NULL),
+  optimizer(OPT_SGD),
+  weight_m(NULL),
+  weight_v(NULL),
+  weight_beta1_t(NULL),
+  weight_beta2_t(NULL),
+  beta1(0.9),
+  beta2(0.999) {}
+
+bool dd::parse_optimizer(const std::string & name, int & optimizer){
+  if(name == "sgd"){
+    optimizer = OPT_SGD;
+  }else if(name == "adagrad"){
+    optimizer = OPT_ADAGRAD;
+  }else if(name == "rmsprop"){
+    optimizer = OPT_RMSPROP;
+  }else if(name == "adam"){
+    optimizer = OPT_ADAM;
+  }else{
+    return false;
+  }
+  return true;
+}
 
 void dd::InferenceResult::init(Variable * variables, Weight * const weights){
 
   ntallies = 0;
   for(long t=0;t<nvars;t++){
     const Variable & variable = variables[t];
-    assignments_free[variable.id] = variable.assignment_free;
-    assignments_evid[variable.id] = variable.assignment_evid;
     agg_means[variable.id] = 0.0;
     agg_nsamples[variable.id] = 0.0;
     if(variable.domain_type == DTYPE_MULTINOMIAL){
@@ -24,14 +58,129 @@ void dd::InferenceResult::init(Variable * variables, Weight * const weights){
     }
   }
 
-  multinomial_tallies = new int[ntallies];
+  multinomial_tallies = new double[ntallies];
   for(long i=0;i<ntallies;i++){
     multinomial_tallies[i] = 0;
   }
 
-  for(long t=0;t<nweights;t++){
+  // weights may already have been released, see FactorGraph::copy_from()
+  for(long t=0;weights!=NULL && t<nweights;t++){
     const Weight & weight = weights[t];
     weight_values[weight.id] = weight.weight;
     weights_isfixed[weight.id] = weight.isfixed;
   }
 }
+
+void dd::InferenceResult::enable_bitpacking(){
+  if(assignments_free_bits == NULL){
+    assignments_free_bits = new BitAssignment(nvars);
+    assignments_evid_bits = new BitAssignment(nvars);
+  }
+}
+
+void dd::InferenceResult::pack_assignments(){
+  if(assignments_free_bits == NULL || is_packed) return;
+  assignments_free_bits->pack(assignments_free);
+  assignments_evid_bits->pack(assignments_evid);
+  is_packed = true;
+}
+
+void dd::InferenceResult::unpack_assignments(){
+  if(!is_packed) return;
+  assignments_free_bits->unpack(assignments_free);
+  assignments_evid_bits->unpack(assignments_evid);
+  is_packed = false;
+}
+
+void dd::InferenceResult::share_bit_words(bool is_shared){
+  if(assignments_free_bits == NULL) return;
+  assignments_free_bits->is_shared = is_shared;
+  assignments_evid_bits->is_shared = is_shared;
+}
+
+void dd::InferenceResult::swap_assignments(InferenceResult & other){
+  assert(is_packed == other.is_packed);
+  if(is_packed){
+    std::swap_ranges(assignments_evid_bits->words, 
+      assignments_evid_bits->words + assignments_evid_bits->nwords, 
+      other.assignments_evid_bits->words);
+  }else{
+    std::swap_ranges(assignments_evid, assignments_evid + nvars, other.assignments_evid);
+  }
+}
+
+void dd::InferenceResult::enable_adaptive_scan(double threshold, double min_prob){
+  scan_threshold = threshold;
+  scan_min_prob = min_prob;
+  if(scan_uncertainty == NULL){
+    scan_uncertainty = alloc_array<float>(nvars, "scan_uncertainty");
+  }
+  reset_adaptive_scan();
+}
+
+void dd::InferenceResult::reset_adaptive_scan(){
+  if(scan_uncertainty == NULL) return;
+  for(long i=0;i<nvars;i++){
+    scan_uncertainty[i] = 0.5;
+  }
+}
+
+void dd::InferenceResult::enable_optimizer(int _optimizer){
+  optimizer = _optimizer;
+  if(optimizer == OPT_RMSPROP){
+    // the usual RMSProp decay, Adam's is slower
+    beta2 = 0.9;
+  }
+  if(optimizer != OPT_SGD && weight_v == NULL){
+    weight_v = alloc_array<double>(nweights, "weight_v");
+  }
+  if(optimizer == OPT_ADAM && weight_m == NULL){
+    weight_m = alloc_array<double>(nweights, "weight_m");
+    weight_beta1_t = alloc_array<double>(nweights, "weight_beta1_t");
+    weight_beta2_t = alloc_array<double>(nweights, "weight_beta2_t");
+  }
+  for(long i=0;weight_v!=NULL && i<nweights;i++){
+    weight_v[i] = 0;
+  }
+  for(long i=0;weight_m!=NULL && i<nweights;i++){
+    weight_m[i] = 0;
+    weight_beta1_t[i] = 1;
+    weight_beta2_t[i] = 1;
+  }
+}
+
+void dd::InferenceResult::enable_chains(int n_chains){
+  if(chains == NULL){
+    chains = new ChainAssignment(nvars, n_chains);
+    chain_means = alloc_array<double>(nvars * n_chains, "chain_means");
+  }
+}
+
+void dd::InferenceResult::reset_chains(const Variable * const variables, bool sample_evidence){
+  if(chains == NULL) return;
+  for(long i=0;i<nvars;i++){
+    const Variable & variable = variables[i];
+    const bool is_sampled = !variable.is_observation && (!variable.is_evid || sample_evidence);
+    for(int c=0;c<chains->nchains;c++){
+      chains->set(variable.id, c, (c > 0 && is_sampled) ? (rand() & 1) : assignments_evid[variable.id]);
+      chain_means[variable.id * chains->nchains + c] = 0;
+    }
+  }
+}
+
+void dd::InferenceResult::disperse_assignments(const Variable * const variables,
+  bool sample_evidence){
+  for(long i=0;i<nvars;i++){
+    const Variable & variable = variables[i];
+    if(variable.is_observation || (variable.is_evid && !sample_evidence)) continue;
+    assignments_evid[variable.id] = variable.lower_bound +
+      rand() % (int)(variable.upper_bound - variable.lower_bound + 1);
+  }
+}
+
+void dd::InferenceResult::save_chains(){
+  if(chains == NULL) return;
+  for(long i=0;i<nvars;i++){
+    assignments_evid[i] = chains->get(i, 0);
+  }
+}
@@ -1,11 +1,31 @@
   
+#include <stddef.h>
+#include <math.h>
+#include <string>
 #include "dstruct/factor_graph/variable.h"
 #include "dstruct/factor_graph/weight.h"
+#include "dstruct/factor_graph/bit_assignment.h"
+#include "dstruct/factor_graph/chain_assignment.h"
 
 #ifndef _INFERENCE_RESULT_H_
 #define _INFERENCE_RESULT_H_
 
 namespace dd {
+
+  // enumeration for the weight update rules used in learning
+  enum OPTIMIZER_TYPE{
+    OPT_SGD     = 0,  // w += stepsize * g
+    OPT_ADAGRAD = 1,  // w += stepsize * g / sqrt(sum of g^2)
+    OPT_RMSPROP = 2,  // w += stepsize * g / sqrt(moving average of g^2)
+    OPT_ADAM    = 3   // w += stepsize * (moving average of g) / sqrt(... of g^2)
+  };
+
+  /**
+   * Parses an optimizer name (sgd, adagrad, rmsprop, adam). Returns false if
+   * unknown.
+   */
+  bool parse_optimizer(const std::string & name, int & optimizer);
+
   /** 
    * Encapsulates inference result statistics
    */
@@ -16,7 +36,9 @@ namespace dd {
     long nweights;  // number of weights
     long ntallies;
 
-    int * multinomial_tallies; // this might be slow...
+    // sum of samples (or of conditional probabilities, see rao_blackwell)
+    // for each value of the multinomial variables
+    double * multinomial_tallies; // this might be slow...
 
     // array of sum of samples for each variable
     double * const agg_means; 
@@ -28,12 +50,174 @@ namespace dd {
     double * const weight_values; // array of weight values
     bool * const weights_isfixed; // array of whether weight is fixed
 
+    // bit-packed assignments for Boolean-only graphs, NULL unless
+    // enable_bitpacking() was called. While is_packed is set they, not
+    // assignments_free/assignments_evid, hold the current assignment.
+    BitAssignment * assignments_free_bits;
+    BitAssignment * assignments_evid_bits;
+    bool is_packed;
+
+    // whether inference accumulates, for each sampled variable, the
+    // conditional distribution it was sampled from (Rao-Blackwellized 
+    // estimator) instead of the sample, see FactorGraph::update_rao_blackwell()
+    bool rao_blackwell;
+
+    // adaptive scan, NULL unless enable_adaptive_scan() was called. During
+    // inference, Boolean variables are visited with probability scan_prob(),
+    // derived from scan_uncertainty, a moving average of min(p, 1-p) over
+    // the conditional probabilities p of 1 they were sampled with. Samples
+    // are weighted by 1/scan_prob() so the marginals stay unbiased.
+    float * scan_uncertainty;
+    double scan_threshold;  // uncertainty at or above which q = 1
+    double scan_min_prob;   // lowest visit probability
+    long n_visits;          // variables visited, see SingleThreadSampler::sample()
+
+    // multi-chain inference, NULL unless enable_chains() was called. Each
+    // thread then advances all chains of the variables it samples at once,
+    // see SingleThreadSampler::sample_single_variable_chains(). The samples
+    // of all chains are accumulated in agg_means/agg_nsamples, and those of
+    // each chain in chain_means[vid*nchains + chain]. Boolean-only graphs.
+    ChainAssignment * chains;
+    double * chain_means;
+
+    // per-weight optimizer state, see apply_gradient(). weight_m (Adam only)
+    // and weight_v are NULL for plain SGD. Like the weights, they are
+    // averaged across the factor graph copies after every learning epoch.
+    int optimizer;
+    double * weight_m;      // moving average of the gradient
+    double * weight_v;      // sum or moving average of the squared gradient
+    double * weight_beta1_t;  // Adam only: beta1^t and beta2^t after the t
+    double * weight_beta2_t;  // updates of the weight, for bias correction
+    double beta1;           // decay of weight_m
+    double beta2;           // decay of weight_v
+
     InferenceResult(long _nvars, long _nweights);
 
     /**
-     * Initialize the class with given variables and weights
+     * Initialize the class with given variables and weights. The assignments
+     * are not touched, they are filled in when loading variables. Weight
+     * values are left alone if weights is NULL.
      */
     void init(Variable * variables, Weight * const weights);
+
+    /**
+     * Allocates the bit-packed assignments. Only valid if all variables
+     * are Boolean.
+     */
+    void enable_bitpacking();
+
+    /**
+     * Moves the assignment into the bit-packed arrays, if enabled
+     */
+    void pack_assignments();
+
+    /**
+     * Moves the assignment back into assignments_free/assignments_evid
+     */
+    void unpack_assignments();
+
+    /**
+     * Sets whether several threads may write variables of the same word of
+     * the bit-packed arrays, see BitAssignment::is_shared
+     */
+    void share_bit_words(bool is_shared);
+
+    /**
+     * Exchanges the evid assignment with the one of other, e.g. of the
+     * replica at the next temperature. Both must be packed or unpacked.
+     */
+    void swap_assignments(InferenceResult & other);
+
+    /**
+     * Allocates the assignments of n_chains chains for inference
+     */
+    void enable_chains(int n_chains);
+
+    /**
+     * Starts all chains from assignments_evid, except that in all chains but
+     * the first the variables that are sampled (see sample_evidence) start
+     * at random values, and clears chain_means
+     */
+    void reset_chains(const Variable * const variables, bool sample_evidence);
+
+    /**
+     * Sets the variables that are sampled (see sample_evidence) to random
+     * values in assignments_evid, so that replicas start apart
+     */
+    void disperse_assignments(const Variable * const variables, bool sample_evidence);
+
+    /**
+     * Copies the first chain back into assignments_evid
+     */
+    void save_chains();
+
+    /**
+     * Switches learning to the given optimizer and resets its state
+     */
+    void enable_optimizer(int _optimizer);
+
+    /**
+     * Ascends weight wid along the stochastic gradient g with the current
+     * optimizer. Zero gradients leave the state alone, so weights of factors
+     * that did not change are not decayed (lazy updates).
+     */
+    inline void apply_gradient(const long & wid, const double & stepsize, const double & g) {
+      if(optimizer == OPT_SGD){
+        weight_values[wid] += stepsize * g;
+        return;
+      }
+      if(g == 0) return;
+      const double eps = 1e-8;
+      switch(optimizer){
+        case OPT_ADAGRAD:
+          weight_v[wid] += g * g;
+          weight_values[wid] += stepsize * g / (sqrt(weight_v[wid]) + eps);
+          break;
+        case OPT_RMSPROP:
+          weight_v[wid] = beta2 * weight_v[wid] + (1 - beta2) * g * g;
+          weight_values[wid] += stepsize * g / (sqrt(weight_v[wid]) + eps);
+          break;
+        case OPT_ADAM:
+          weight_m[wid] = beta1 * weight_m[wid] + (1 - beta1) * g;
+          weight_v[wid] = beta2 * weight_v[wid] + (1 - beta2) * g * g;
+          weight_beta1_t[wid] *= beta1;
+          weight_beta2_t[wid] *= beta2;
+          weight_values[wid] += stepsize * weight_m[wid] / (1 - weight_beta1_t[wid]) /
+            (sqrt(weight_v[wid] / (1 - weight_beta2_t[wid])) + eps);
+          break;
+      }
+    }
+
+    /**
+     * Allocates the adaptive scan state with the given threshold and minimum
+     * visit probability
+     */
+    void enable_adaptive_scan(double threshold, double min_prob);
+
+    /**
+     * Resets all variables to be visited with probability 1
+     */
+    void reset_adaptive_scan();
+
+    /**
+     * Returns the probability variable vid is visited with, 1 if adaptive
+     * scan is not enabled
+     */
+    inline double scan_prob(const long & vid) const {
+      if(scan_uncertainty == NULL) return 1.0;
+      const double q = scan_uncertainty[vid] / scan_threshold;
+      return q >= 1.0 ? 1.0 : (q <= scan_min_prob ? scan_min_prob : q);
+    }
+
+    /**
+     * Records that Boolean variable vid was sampled with conditional
+     * probability p_true of 1
+     */
+    inline void update_scan(const long & vid, const double & p_true) {
+      if(scan_uncertainty == NULL) return;
+      const double u = p_true < 0.5 ? p_true : 1 - p_true;
+      scan_uncertainty[vid] = 0.5 * (scan_uncertainty[vid] + u);
+    }
   };
 }
 
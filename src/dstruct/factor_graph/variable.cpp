@@ -6,8 +6,8 @@ namespace dd{
 
     Variable::Variable(const long & _id, const int & _domain_type, 
              const bool & _is_evid, const VariableValue & _lower_bound,
-             const VariableValue & _upper_bound, const VariableValue & _init_value, 
-             const VariableValue & _current_value, const int & _n_factors, bool is_observation){
+             const VariableValue & _upper_bound, const int & _n_factors, 
+             bool is_observation){
 
       this->id = _id;
       this->domain_type = _domain_type;
@@ -15,8 +15,6 @@ namespace dd{
       this->is_observation = is_observation;
       this->lower_bound = _lower_bound;
       this->upper_bound = _upper_bound;
-      this->assignment_evid = _init_value;
-      this->assignment_free = _current_value;
 
       this->n_factors = _n_factors;
     }
@@ -16,21 +16,15 @@ namespace dd{
 
   /**
    * A variable in factor graph
+   *
+   * Only the fields the samplers read are kept here, so that the variable
+   * array stays compact (48 bytes per variable). Assignments live in 
+   * InferenceResult, and the factors a variable connects to are derived from
+   * the factors at load time (see FactorGraph::organize_graph_by_edge()).
    */
   class Variable {
   public:
     long id;                        // variable id
-    int domain_type;                // variable domain type, can be DTYPE_BOOLEAN or 
-                                    // DTYPE_MULTINOMIAL
-    bool is_evid;                   // whether the variable is evidence
-    bool is_observation;
-    VariableValue lower_bound;      // lower bound
-    VariableValue upper_bound;      // upper bound
-    
-    VariableValue assignment_evid;  // assignment, while keeping evidence variables unchanged
-    VariableValue assignment_free;  // assignment, free to change any variable
-
-    int n_factors;                  // number of factors the variable connects to
     long n_start_i_factors;         // id of the first factor
 
     // the values of multinomial variables are stored in an array like this
@@ -39,18 +33,24 @@ namespace dd{
     // n_start_i_tally is the start position for the variable values in the array
     long n_start_i_tally;
 
-    std::vector<long> tmp_factor_ids; // factor ids the variable connects to
+    int n_factors;                  // number of factors the variable connects to
+    VariableValue lower_bound;      // lower bound
+    VariableValue upper_bound;      // upper bound
+    int domain_type;                // variable domain type, can be DTYPE_BOOLEAN or 
+                                    // DTYPE_MULTINOMIAL
+    bool is_evid;                   // whether the variable is evidence
+    bool is_observation;
 
     Variable();
 
     /**
      * Constructs a variable with id, domain type, is evidence, lower bound, 
-     * upper bound, initial value, current value, number of factors 
+     * upper bound, number of factors 
      */
     Variable(const long & _id, const int & _domain_type, 
              const bool & _is_evid, const VariableValue & _lower_bound,
-             const VariableValue & _upper_bound, const VariableValue & _init_value, 
-             const VariableValue & _current_value, const int & _n_factors, bool is_observation);
+             const VariableValue & _upper_bound, const int & _n_factors, 
+             bool is_observation);
   };
 
   /**
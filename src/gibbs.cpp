@@ -1,8 +1,38 @@
 
 #include "gibbs.h"
 #include "dstruct/factor_graph/inference_result.h"
+#include "dstruct/allocator.h"
 #include <iostream>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
+
+/*
+ * Prints the peak RSS during the given phase, which ends now, and resets it
+ * for the next phase; where it cannot be reset, the peak RSS so far
+ */
+static void print_peak_rss(const std::string & phase, bool is_quiet){
+  // the first phase starts with the process
+  static bool is_per_phase = true;
+  if (!is_quiet) {
+    std::cout << (is_per_phase ? "PEAK RSS DURING " : "PEAK RSS SO FAR, AFTER ") << phase 
+      << ": " << peak_rss_bytes() << " bytes" << std::endl;
+  }
+  is_per_phase = reset_peak_rss();
+}
+
+/*
+ * Prints the memory used by each replica of the factor graph
+ */
+static void print_memory_usage(dd::GibbsSampling & gibbs, bool is_quiet){
+  if (is_quiet) return;
+  long total = 0;
+  for (size_t i = 0; i < gibbs.factorgraphs.size(); i++) {
+    total += gibbs.factorgraphs[i].print_memory_usage(std::cout,
+      "REPLICA " + std::to_string(i));
+  }
+  std::cout << "MEMORY USAGE OF ALL REPLICAS: " << total << " bytes" << std::endl;
+}
 
 /*
  * Parse input arguments
@@ -36,253 +66,319 @@ dd::CmdParser parse_input(int argc, char** argv){
   return cmd_parser;
 }
 
-void gibbs(dd::CmdParser & cmd_parser){
-
+/*
+ * The command line arguments that gibbs, em and map share
+ */
+struct AppArgs {
+  int n_numa_node;
+  int n_learning_epoch;
+  int n_samples_per_learning_epoch;
+  int n_inference_epoch;
+  double stepsize;
+  double decay;
+  int n_datacopy;
+  double reg_param;
+  double reg1_param;
+  bool is_quiet;
+  bool sample_evidence;
+  int burn_in;
+  bool learn_non_evidence;
+};
+
+static AppArgs read_app_args(dd::CmdParser & cmd_parser){
+  AppArgs args;
   // number of NUMA nodes
-  int n_numa_node = numa_max_node() + 1;
-  // number of max threads per NUMA node
-  int n_thread_per_numa = (sysconf(_SC_NPROCESSORS_CONF))/(n_numa_node);
-
-  // get command line arguments
-  std::string fg_file = cmd_parser.fg_file->getValue();
-
-  std::string weight_file = cmd_parser.weight_file->getValue();
-  std::string variable_file = cmd_parser.variable_file->getValue();
-  std::string factor_file = cmd_parser.factor_file->getValue();
-  std::string edge_file = cmd_parser.edge_file->getValue();
-  std::string meta_file = cmd_parser.meta_file->getValue();
-
-  std::string output_folder = cmd_parser.output_folder->getValue();
+  args.n_numa_node = numa_max_node() + 1;
 
-  int n_learning_epoch = cmd_parser.n_learning_epoch->getValue();
-  int n_samples_per_learning_epoch = cmd_parser.n_samples_per_learning_epoch->getValue();
-  int n_inference_epoch = cmd_parser.n_inference_epoch->getValue();
+  args.n_learning_epoch = cmd_parser.n_learning_epoch->getValue();
+  args.n_samples_per_learning_epoch = cmd_parser.n_samples_per_learning_epoch->getValue();
+  args.n_inference_epoch = cmd_parser.n_inference_epoch->getValue();
 
-  double stepsize = cmd_parser.stepsize->getValue();
+  args.stepsize = cmd_parser.stepsize->getValue();
   double stepsize2 = cmd_parser.stepsize2->getValue();
   // hack to support two parameters to specify step size
-  if (stepsize == 0.01) stepsize = stepsize2;
-  double decay = cmd_parser.decay->getValue();
-
-  int n_datacopy = cmd_parser.n_datacopy->getValue();
-  double reg_param = cmd_parser.reg_param->getValue();
-  double reg1_param = cmd_parser.reg1_param->getValue();
-  bool is_quiet = cmd_parser.quiet->getValue();
-  bool sample_evidence = cmd_parser.sample_evidence->getValue();
-  int burn_in = cmd_parser.burn_in->getValue();
-  bool learn_non_evidence = cmd_parser.learn_non_evidence->getValue();
-
-  Meta meta = read_meta(fg_file); 
+  if (args.stepsize == 0.01) args.stepsize = stepsize2;
+  args.decay = cmd_parser.decay->getValue();
+
+  args.n_datacopy = cmd_parser.n_datacopy->getValue();
+  args.reg_param = cmd_parser.reg_param->getValue();
+  args.reg1_param = cmd_parser.reg1_param->getValue();
+  args.is_quiet = cmd_parser.quiet->getValue();
+  args.sample_evidence = cmd_parser.sample_evidence->getValue();
+  args.burn_in = cmd_parser.burn_in->getValue();
+  args.learn_non_evidence = cmd_parser.learn_non_evidence->getValue();
+  return args;
+}
 
-  if (is_quiet) {
+/*
+ * Prints the configuration of a run, with the settings of the given app
+ * after the shared ones
+ */
+static void print_banner(dd::CmdParser & cmd_parser, const AppArgs & args, const Meta & meta,
+  const std::string & title, const std::vector<std::pair<std::string, std::string> > & settings){
+  if (args.is_quiet) {
     std::cout << "Running in quiet mode..." << std::endl;
-  } else {
-    std::cout << std::endl;
-    std::cout << "#################MACHINE CONFIG#################" << std::endl;
-    std::cout << "# # NUMA Node        : " << n_numa_node << std::endl;
-    std::cout << "# # Thread/NUMA Node : " << n_thread_per_numa << std::endl;
-    std::cout << "################################################" << std::endl;
-    std::cout << std::endl;
-    std::cout << "#################GIBBS SAMPLING#################" << std::endl;
-    std::cout << "# fg_file            : " << fg_file << std::endl;
-    std::cout << "# edge_file          : " << edge_file << std::endl;
-    std::cout << "# weight_file        : " << weight_file << std::endl;
-    std::cout << "# variable_file      : " << variable_file << std::endl;
-    std::cout << "# factor_file        : " << factor_file << std::endl;
-    std::cout << "# meta_file          : " << meta_file << std::endl;
-    std::cout << "# output_folder      : " << output_folder << std::endl;
-    std::cout << "# n_learning_epoch   : " << n_learning_epoch << std::endl;
-    std::cout << "# n_samples/l. epoch : " << n_samples_per_learning_epoch << std::endl;
-    std::cout << "# n_inference_epoch  : " << n_inference_epoch << std::endl;
-    std::cout << "# stepsize           : " << stepsize << std::endl;
-    std::cout << "# decay              : " << decay << std::endl;
-    std::cout << "# regularization     : " << reg_param << std::endl;
-    std::cout << "# l1 regularization     : " << reg1_param << std::endl;
-    std::cout << "################################################" << std::endl;
-    std::cout << "# IGNORE -s (n_samples/l. epoch). ALWAYS -s 1. #" << std::endl;
-    std::cout << "# IGNORE -t (threads). ALWAYS USE ALL THREADS. #" << std::endl;
-    std::cout << "################################################" << std::endl;
-
-
-    std::cout << "# nvar               : " << meta.num_variables << std::endl;
-    std::cout << "# nfac               : " << meta.num_factors << std::endl;
-    std::cout << "# nweight            : " << meta.num_weights << std::endl;
-    std::cout << "# nedge              : " << meta.num_edges << std::endl;
-    std::cout << "################################################" << std::endl;
+    return;
   }
+  // number of max threads per NUMA node
+  int n_thread_per_numa = (sysconf(_SC_NPROCESSORS_CONF))/(args.n_numa_node);
+
+  std::cout << std::endl;
+  std::cout << "#################MACHINE CONFIG#################" << std::endl;
+  std::cout << "# # NUMA Node        : " << args.n_numa_node << std::endl;
+  std::cout << "# # Thread/NUMA Node : " << n_thread_per_numa << std::endl;
+  std::cout << "################################################" << std::endl;
+  std::cout << std::endl;
+  std::cout << title << std::endl;
+  std::cout << "# fg_file            : " << cmd_parser.fg_file->getValue() << std::endl;
+  std::cout << "# edge_file          : " << cmd_parser.edge_file->getValue() << std::endl;
+  std::cout << "# weight_file        : " << cmd_parser.weight_file->getValue() << std::endl;
+  std::cout << "# variable_file      : " << cmd_parser.variable_file->getValue() << std::endl;
+  std::cout << "# factor_file        : " << cmd_parser.factor_file->getValue() << std::endl;
+  std::cout << "# meta_file          : " << cmd_parser.meta_file->getValue() << std::endl;
+  std::cout << "# output_folder      : " << cmd_parser.output_folder->getValue() << std::endl;
+  std::cout << "# n_learning_epoch   : " << args.n_learning_epoch << std::endl;
+  std::cout << "# n_samples/l. epoch : " << args.n_samples_per_learning_epoch << std::endl;
+  std::cout << "# n_inference_epoch  : " << args.n_inference_epoch << std::endl;
+  std::cout << "# stepsize           : " << args.stepsize << std::endl;
+  std::cout << "# decay              : " << args.decay << std::endl;
+  std::cout << "# regularization     : " << args.reg_param << std::endl;
+  std::cout << "# l1 regularization     : " << args.reg1_param << std::endl;
+  std::cout << "# optimizer          : " << cmd_parser.optimizer->getValue() << std::endl;
+  std::cout << "# huge_pages         : " << cmd_parser.huge_pages->getValue() 
+    << (cmd_parser.prefault->getValue() ? " (prefault)" : "") << std::endl;
+  for (size_t i = 0; i < settings.size(); i++) {
+    std::cout << "# " << std::left << std::setw(19) << settings[i].first << std::right 
+      << ": " << settings[i].second << std::endl;
+  }
+  std::cout << "################################################" << std::endl;
+  std::cout << "# IGNORE -s (n_samples/l. epoch). ALWAYS -s 1. #" << std::endl;
+  std::cout << "# IGNORE -t (threads). ALWAYS USE ALL THREADS. #" << std::endl;
+  std::cout << "################################################" << std::endl;
+
 
+  std::cout << "# nvar               : " << meta.num_variables << std::endl;
+  std::cout << "# nfac               : " << meta.num_factors << std::endl;
+  std::cout << "# nweight            : " << meta.num_weights << std::endl;
+  std::cout << "# nedge              : " << meta.num_edges << std::endl;
+  std::cout << "################################################" << std::endl;
+}
+
+/*
+ * Runs on NUMA node 0 and sets the allocation policy for the large factor
+ * graph arrays; returns the policy
+ */
+static int set_up_allocation(dd::CmdParser & cmd_parser){
   // run on NUMA node 0
   numa_run_on_node(0);
   numa_set_localalloc();
 
-  // load factor graph
-  dd::FactorGraph fg(meta.num_variables, meta.num_factors, meta.num_weights, meta.num_edges);
-  fg.load(cmd_parser, is_quiet);
-  dd::GibbsSampling gibbs(&fg, &cmd_parser, n_datacopy, sample_evidence, burn_in, learn_non_evidence);
+  std::string huge_pages = cmd_parser.huge_pages->getValue();
+  int alloc_policy;
+  if (!dd::parse_alloc_policy(huge_pages, alloc_policy)) {
+    std::cout << "[ERROR] Unknown --huge_pages policy " << huge_pages << std::endl;
+    exit(1);
+  }
+  dd::set_alloc_policy(alloc_policy, cmd_parser.prefault->getValue());
+  return alloc_policy;
+}
+
+/*
+ * Loads the factor graph, builds its inference view if simplify_inference,
+ * and releases the load-only structures
+ */
+static void load_factor_graph(dd::FactorGraph & fg, dd::CmdParser & cmd_parser, 
+  const AppArgs & args, bool simplify_inference){
+  fg.load(cmd_parser, args.is_quiet);
+  // simplify the graph for inference, before the factors are released
+  if (simplify_inference) {
+    fg.build_inference_view(args.sample_evidence, args.is_quiet);
+  }
+  print_peak_rss("LOADING", args.is_quiet);
+  // the edge-based store is built, the load-only structures can go
+  fg.release_load_only();
+}
+
+/*
+ * Prints the allocations and memory of the replicas gibbs made
+ */
+static void print_replication(dd::GibbsSampling & gibbs, int alloc_policy, bool is_quiet){
+  if (!is_quiet && alloc_policy != dd::ALLOC_DEFAULT) {
+    dd::print_alloc_report(std::cout);
+  }
+  print_memory_usage(gibbs, is_quiet);
+  print_peak_rss("REPLICATION", is_quiet);
+}
 
-  // number of learning epochs
-  // the factor graph is copied on each NUMA node, so the total epochs =
-  // epochs specified / number of NUMA nodes
-  int numa_aware_n_learning_epoch = (int)(n_learning_epoch/n_numa_node) + 
-                            (n_learning_epoch%n_numa_node==0?0:1);
+/*
+ * The factor graph is copied on each NUMA node, so the total epochs =
+ * epochs specified / number of NUMA nodes
+ */
+static int numa_aware_epochs(int n_epoch, const AppArgs & args){
+  return (int)(n_epoch/args.n_numa_node) + (n_epoch%args.n_numa_node==0?0:1);
+}
 
+/*
+ * Learns the weights and dumps them
+ */
+static void learn_and_dump(dd::GibbsSampling & gibbs, const AppArgs & args){
   // learning
-  /*gibbs.learn(numa_aware_n_learning_epoch, n_samples_per_learning_epoch,
-    stepsize, decay, reg_param, reg1_param, meta_file, is_quiet);*/
-  gibbs.learn(numa_aware_n_learning_epoch, n_samples_per_learning_epoch,
-              stepsize, decay, reg_param, reg1_param, is_quiet);
+  gibbs.learn(numa_aware_epochs(args.n_learning_epoch, args), args.n_samples_per_learning_epoch,
+              args.stepsize, args.decay, args.reg_param, args.reg1_param, args.is_quiet);
 
   // dump weights
-  gibbs.dump_weights(is_quiet);
+  gibbs.dump_weights(args.is_quiet);
+  print_peak_rss("LEARNING", args.is_quiet);
+}
 
-  // number of inference epochs
-  int numa_aware_n_epoch = (int)(n_inference_epoch/n_numa_node) + 
-                            (n_inference_epoch%n_numa_node==0?0:1);
+void gibbs(dd::CmdParser & cmd_parser){
 
-  // inference
-  gibbs.inference(numa_aware_n_epoch, is_quiet);
-  gibbs.aggregate_results_and_dump(is_quiet);
+  AppArgs args = read_app_args(cmd_parser);
+  bool simplify_inference = cmd_parser.simplify_inference->getValue();
+  std::string inference_engine = cmd_parser.inference_engine->getValue();
 
+  Meta meta = read_meta(cmd_parser.fg_file->getValue()); 
 
-  // print weights from inference result
-  for(long t=0;t<fg.n_weight;t++) {
-      std::cout<<fg.infrs->weight_values[t]<<std::endl;
-  }
+  print_banner(cmd_parser, args, meta, "#################GIBBS SAMPLING#################", {
+    {"simplify_inference", std::to_string(simplify_inference)},
+    {"inference_engine", inference_engine}});
 
-  // print weights from factor graph
-  std::cout<<"PRINTING WEIGHTS FROM WEIGHT VARIABLE"<<std::endl;
-  for(long t=0;t<fg.n_weight;t++) {
-      std::cout<<fg.weights[t].weight<<std::endl;
-  }
-}
+  int alloc_policy = set_up_allocation(cmd_parser);
 
-void em(dd::CmdParser & cmd_parser){
+  if (inference_engine != "gibbs" && inference_engine != "meanfield") {
+    std::cout << "[ERROR] Unknown --inference_engine " << inference_engine << std::endl;
+    exit(1);
+  }
 
-  // number of NUMA nodes
-  int n_numa_node = numa_max_node() + 1;
-  // number of max threads per NUMA node
-  int n_thread_per_numa = (sysconf(_SC_NPROCESSORS_CONF))/(n_numa_node);
+  // load factor graph
+  dd::FactorGraph fg(meta.num_variables, meta.num_factors, meta.num_weights, meta.num_edges);
+  load_factor_graph(fg, cmd_parser, args, simplify_inference);
+  dd::GibbsSampling gibbs(&fg, &cmd_parser, args.n_datacopy, args.sample_evidence, 
+    args.burn_in, args.learn_non_evidence);
+  print_replication(gibbs, alloc_policy, args.is_quiet);
 
-  // get command line arguments
-  std::string fg_file = cmd_parser.fg_file->getValue();
+  learn_and_dump(gibbs, args);
 
-  std::string weight_file = cmd_parser.weight_file->getValue();
-  std::string variable_file = cmd_parser.variable_file->getValue();
-  std::string factor_file = cmd_parser.factor_file->getValue();
-  std::string edge_file = cmd_parser.edge_file->getValue();
-  std::string meta_file = cmd_parser.meta_file->getValue();
+  // inference, mean-field takes -i as its iterations
+  if (inference_engine == "meanfield") {
+    gibbs.mean_field(args.n_inference_epoch, args.is_quiet);
+  } else {
+    gibbs.inference(numa_aware_epochs(args.n_inference_epoch, args), args.is_quiet);
+  }
+  gibbs.aggregate_results_and_dump(args.is_quiet);
+  print_peak_rss("INFERENCE", args.is_quiet);
 
-  std::string output_folder = cmd_parser.output_folder->getValue();
 
-  int n_learning_epoch = cmd_parser.n_learning_epoch->getValue();
-  int n_samples_per_learning_epoch = cmd_parser.n_samples_per_learning_epoch->getValue();
-  int n_inference_epoch = cmd_parser.n_inference_epoch->getValue();
+  // print weights from inference result
+  for(long t=0;t<fg.n_weight;t++) {
+      std::cout<<fg.infrs->weight_values[t]<<std::endl;
+  }
+}
 
-  double stepsize = cmd_parser.stepsize->getValue();
-  double stepsize2 = cmd_parser.stepsize2->getValue();
-  // hack to support two parameters to specify step size
-  if (stepsize == 0.01) stepsize = stepsize2;
-  double decay = cmd_parser.decay->getValue();
+void em(dd::CmdParser & cmd_parser){
 
-  int n_datacopy = cmd_parser.n_datacopy->getValue();
-  double reg_param = cmd_parser.reg_param->getValue();
-  double reg1_param = cmd_parser.reg1_param->getValue();
-  bool is_quiet = cmd_parser.quiet->getValue();
+  AppArgs args = read_app_args(cmd_parser);
   bool check_convergence = cmd_parser.check_convergence->getValue();
-  bool sample_evidence = cmd_parser.sample_evidence->getValue();
-  int burn_in = cmd_parser.burn_in->getValue();
   int n_iter = cmd_parser.n_iter->getValue();
   int wl_conv = cmd_parser.wl_conv->getValue();
   int delta = cmd_parser.delta->getValue();
-  bool learn_non_evidence = cmd_parser.learn_non_evidence->getValue();
 
-  Meta meta = read_meta(fg_file);
+  Meta meta = read_meta(cmd_parser.fg_file->getValue());
 
-  if (is_quiet) {
-    std::cout << "Running in quiet mode..." << std::endl;
-  } else {
-    std::cout << std::endl;
-    std::cout << "#################MACHINE CONFIG#################" << std::endl;
-    std::cout << "# # NUMA Node        : " << n_numa_node << std::endl;
-    std::cout << "# # Thread/NUMA Node : " << n_thread_per_numa << std::endl;
-    std::cout << "################################################" << std::endl;
-    std::cout << std::endl;
-    std::cout << "#################GIBBS SAMPLING#################" << std::endl;
-    std::cout << "# fg_file            : " << fg_file << std::endl;
-    std::cout << "# edge_file          : " << edge_file << std::endl;
-    std::cout << "# weight_file        : " << weight_file << std::endl;
-    std::cout << "# variable_file      : " << variable_file << std::endl;
-    std::cout << "# factor_file        : " << factor_file << std::endl;
-    std::cout << "# meta_file          : " << meta_file << std::endl;
-    std::cout << "# output_folder      : " << output_folder << std::endl;
-    std::cout << "# n_learning_epoch   : " << n_learning_epoch << std::endl;
-    std::cout << "# n_samples/l. epoch : " << n_samples_per_learning_epoch << std::endl;
-    std::cout << "# n_inference_epoch  : " << n_inference_epoch << std::endl;
-    std::cout << "# stepsize           : " << stepsize << std::endl;
-    std::cout << "# decay              : " << decay << std::endl;
-    std::cout << "# regularization     : " << reg_param << std::endl;
-    std::cout << "# l1 regularization     : " << reg1_param << std::endl;
-    std::cout << "################################################" << std::endl;
-    std::cout << "# IGNORE -s (n_samples/l. epoch). ALWAYS -s 1. #" << std::endl;
-    std::cout << "# IGNORE -t (threads). ALWAYS USE ALL THREADS. #" << std::endl;
-    std::cout << "################################################" << std::endl;
-
-
-    std::cout << "# nvar               : " << meta.num_variables << std::endl;
-    std::cout << "# nfac               : " << meta.num_factors << std::endl;
-    std::cout << "# nweight            : " << meta.num_weights << std::endl;
-    std::cout << "# nedge              : " << meta.num_edges << std::endl;
-    std::cout << "################################################" << std::endl;
-  }
+  print_banner(cmd_parser, args, meta, "#################GIBBS SAMPLING#################", {});
 
-  // run on NUMA node 0
-  numa_run_on_node(0);
-  numa_set_localalloc();
+  int alloc_policy = set_up_allocation(cmd_parser);
+
+  // em turns sampled worlds into evidence between iterations, so the fixed
+  // values an inference view substitutes would not stay fixed
+  if (cmd_parser.simplify_inference->getValue()) {
+    std::cout << "[WARNING] --simplify_inference is not supported by em, ignoring it" << std::endl;
+  }
 
   // load factor graph
   dd::FactorGraph fg(meta.num_variables, meta.num_factors, meta.num_weights, meta.num_edges);
-  fg.load(cmd_parser, is_quiet);
-  dd::GibbsSampling gibbs(&fg, &cmd_parser, n_datacopy, sample_evidence, burn_in, learn_non_evidence);
+  load_factor_graph(fg, cmd_parser, args, false);
+  dd::GibbsSampling gibbs(&fg, &cmd_parser, args.n_datacopy, args.sample_evidence, 
+    args.burn_in, args.learn_non_evidence);
+  print_replication(gibbs, alloc_policy, args.is_quiet);
 
   // Initialize EM instance
   dd::ExpMax expMax(&fg, &gibbs, wl_conv, delta, check_convergence);
 
-  // number of inference epochs
-  int numa_aware_n_epoch;
-  int numa_aware_n_learning_epoch;
+  // number of epochs
+  int numa_aware_n_epoch = numa_aware_epochs(args.n_inference_epoch, args);
+  int numa_aware_n_learning_epoch = numa_aware_epochs(args.n_learning_epoch, args);
 
   // EM init -- run Maximzation (semi-supervised learning)
 
   // Maximization step
-  numa_aware_n_learning_epoch = (int)(n_learning_epoch/n_numa_node) +
-                                (n_learning_epoch%n_numa_node==0?0:1);
-  expMax.maximization(numa_aware_n_learning_epoch, n_samples_per_learning_epoch,
-                      stepsize, decay, reg_param, reg1_param, is_quiet);
+  expMax.maximization(numa_aware_n_learning_epoch, args.n_samples_per_learning_epoch,
+                      args.stepsize, args.decay, args.reg_param, args.reg1_param, args.is_quiet);
   /*expMax.maximization(numa_aware_n_learning_epoch, n_samples_per_learning_epoch,
                       stepsize, decay, reg_param, reg1_param, meta_file, is_quiet);*/
 
   while (!expMax.hasConverged && n_iter > 0) {
 
     // Expectation step
-    numa_aware_n_epoch = (int)(n_inference_epoch/n_numa_node) +
-                         (n_inference_epoch%n_numa_node==0?0:1);
-    expMax.expectation(numa_aware_n_epoch,is_quiet);
+    expMax.expectation(numa_aware_n_epoch, args.is_quiet);
 
 
     // Maximization step
-    numa_aware_n_learning_epoch = (int)(n_learning_epoch/n_numa_node) +
-                                  (n_learning_epoch%n_numa_node==0?0:1);
     /*expMax.maximization(numa_aware_n_learning_epoch, n_samples_per_learning_epoch,
                         stepsize, decay, reg_param, reg1_param, meta_file, is_quiet);*/
-    expMax.maximization(numa_aware_n_learning_epoch, n_samples_per_learning_epoch,
-                        stepsize, decay, reg_param, reg1_param, is_quiet);
+    expMax.maximization(numa_aware_n_learning_epoch, args.n_samples_per_learning_epoch,
+                        args.stepsize, args.decay, args.reg_param, args.reg1_param, args.is_quiet);
 
     //Decrement iteration counter
     n_iter--;
   }
+  print_peak_rss("EM", args.is_quiet);
 
-  expMax.dump_weights(is_quiet);
-  expMax.aggregate_results_and_dump(is_quiet);
+  expMax.dump_weights(args.is_quiet);
+  expMax.aggregate_results_and_dump(args.is_quiet);
 
 
 }
+
+void map_inference(dd::CmdParser & cmd_parser){
+
+  AppArgs args = read_app_args(cmd_parser);
+  bool simplify_inference = cmd_parser.simplify_inference->getValue();
+  double start_temperature = cmd_parser.anneal_start_temperature->getValue();
+  double end_temperature = cmd_parser.anneal_end_temperature->getValue();
+
+  Meta meta = read_meta(cmd_parser.fg_file->getValue());
+
+  std::ostringstream temperatures;
+  temperatures << start_temperature << " -> " << end_temperature;
+  print_banner(cmd_parser, args, meta, "#################MAP INFERENCE##################", {
+    {"simplify_inference", std::to_string(simplify_inference)},
+    {"temperatures", temperatures.str()}});
+
+  if (start_temperature <= 0 || end_temperature <= 0) {
+    std::cout << "[ERROR] Annealing temperatures must be positive" << std::endl;
+    exit(1);
+  }
+  // the annealed chains are the assignments of the copies themselves
+  if (cmd_parser.n_chains->getValue() > 1) {
+    std::cout << "[ERROR] --n_chains is not supported by map" << std::endl;
+    exit(1);
+  }
+
+  int alloc_policy = set_up_allocation(cmd_parser);
+
+  // load factor graph
+  dd::FactorGraph fg(meta.num_variables, meta.num_factors, meta.num_weights, meta.num_edges);
+  load_factor_graph(fg, cmd_parser, args, simplify_inference);
+  dd::GibbsSampling gibbs(&fg, &cmd_parser, args.n_datacopy, args.sample_evidence, 
+    args.burn_in, args.learn_non_evidence);
+  print_replication(gibbs, alloc_policy, args.is_quiet);
+
+  learn_and_dump(gibbs, args);
+
+  // annealing, every copy is an independent run
+  dd::MapInference map(&fg, &gibbs, start_temperature, end_temperature);
+  map.anneal(args.n_inference_epoch, args.is_quiet);
+  map.dump(args.is_quiet);
+  print_peak_rss("MAP INFERENCE", args.is_quiet);
+}
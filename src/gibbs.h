@@ -10,6 +10,7 @@
 
 #include "app/gibbs/gibbs_sampling.h"
 #include "app/em/expmax.h"
+#include "app/map/map_inference.h"
 #include "dstruct/factor_graph/factor_graph.h"
 
 /*
@@ -27,6 +28,12 @@ void gibbs(dd::CmdParser & cmd_parser);
  */
 void em(dd::CmdParser & cmd_parser);
 
+/**
+ * Runs learning, then MAP inference by simulated annealing, using the given
+ * command line parser
+ */
+void map_inference(dd::CmdParser & cmd_parser);
+
 
 
 
@@ -105,40 +105,49 @@ long long read_variables(string filename, dd::FactorGraph &fg)
 
         bool is_observation = (isevidence == 2);
 
+        // wrong id
+        if(id >= fg.n_var || id < 0){
+          assert(false);
+        }
+
+        // initial assignment, evidence variables start at their value
+        fg.infrs->assignments_evid[id] = (isevidence || type == 3) ? initial_value : 0;
+        fg.infrs->assignments_free[id] = (isevidence || type == 3) ? initial_value : 0;
+
         // add to factor graph
         if (type == 0){ // boolean
             if (isevidence) {
                 fg.variables[fg.c_nvar] = dd::Variable(id, DTYPE_BOOLEAN, true, 0, 1, 
-                    initial_value, initial_value, edge_count, is_observation);
+                    edge_count, is_observation);
                 fg.c_nvar++;
                 fg.n_evid++;
             } else {
                 fg.variables[fg.c_nvar] = dd::Variable(id, DTYPE_BOOLEAN, false, 0, 1, 
-                    0, 0, edge_count, is_observation);
+                    edge_count, is_observation);
                 fg.c_nvar++;
                 fg.n_query++;
             }
         } else if (type == 1) { // multinomial
             if (isevidence) {
                 fg.variables[fg.c_nvar] = dd::Variable(id, DTYPE_MULTINOMIAL, true, 0, 
-                    cardinality-1, initial_value, initial_value, edge_count, is_observation);
+                    cardinality-1, edge_count, is_observation);
                 fg.c_nvar ++;
                 fg.n_evid ++;
             } else {
                 fg.variables[fg.c_nvar] = dd::Variable(id, DTYPE_MULTINOMIAL, false, 0, 
-                    cardinality-1, 0, 0, edge_count, is_observation);
+                    cardinality-1, edge_count, is_observation);
                 fg.c_nvar ++;
                 fg.n_query ++;
             }
         } else if (type == 3){
             if (isevidence) {
                 fg.variables[fg.c_nvar] = dd::Variable(id, DTYPE_REAL, true, 0, cardinality, 
-                    initial_value, initial_value, edge_count, is_observation);
+                    edge_count, is_observation);
                 fg.c_nvar++;
                 fg.n_evid++;
             }else{
                 fg.variables[fg.c_nvar] = dd::Variable(id, DTYPE_REAL, true, 0, cardinality, 
-                    initial_value, initial_value, edge_count, is_observation);
+                    edge_count, is_observation);
                 fg.c_nvar++;
                 fg.n_evid++;
             }
@@ -221,7 +230,6 @@ long long read_edges(string filename, dd::FactorGraph &fg)
             fg.factors[factor_id].tmp_variables.push_back(
                 dd::VariableInFactor(variable_id, position, ispositive, equal_predicate));
         }
-        fg.variables[variable_id].tmp_factor_ids.push_back(factor_id);
 
     }
     file.close();
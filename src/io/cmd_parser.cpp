@@ -7,7 +7,7 @@ namespace dd{
 
       app_name = _app_name;      
 
-      if(app_name == "gibbs" || app_name == "em"){
+      if(app_name == "gibbs" || app_name == "em" || app_name == "map"){
         cmd = new TCLAP::CmdLine("DimmWitted GIBBS", ' ', "0.01");
 
         fg_file = new TCLAP::ValueArg<std::string>("m","fg_meta","factor graph metadata file",true,"","string"); 
@@ -39,6 +39,38 @@ namespace dd{
         wl_conv = new TCLAP::ValueArg<int>("z", "wl_conv", "Window length to compute pseudo-likelihood convergence", false, 5, "int");
         delta = new TCLAP::ValueArg<int>("x", "delta", "Covergence if pseudo-likelihood difference percentage is below 10^-<delta>", false, 2, "int");
         check_convergence = new TCLAP::SwitchArg("", "check_convergence", "stop EM when convergence criterion is met", false);
+        boolean_bitpack = new TCLAP::SwitchArg("", "boolean_bitpack", "pack assignments one bit per variable for Boolean-only graphs", false);
+        simplify_inference = new TCLAP::SwitchArg("", "simplify_inference", "drop constant factors and substitute fixed values into factors for inference", false);
+        fold_unary = new TCLAP::SwitchArg("", "fold_unary", "fold unary factors of Boolean variables into per-variable biases", false);
+        dedupe_factors = new TCLAP::SwitchArg("", "dedupe_factors", "merge identical factors into one factor with a multiplicity", false);
+        rao_blackwell = new TCLAP::SwitchArg("", "rao_blackwell", "estimate marginals from the conditional probabilities instead of the samples", false);
+        inference_tolerance = new TCLAP::ValueArg<double>("", "inference_tolerance", "stop inference once no marginal changes by more than this in an epoch (0: never)", false, 0, "double");
+        rhat_threshold = new TCLAP::ValueArg<double>("", "rhat_threshold", "stop inference once R-hat across factor graph copies is below this (0: never)", false, 0, "double");
+        adaptive_scan = new TCLAP::ValueArg<double>("", "adaptive_scan", "in inference, visit Boolean variables whose conditional min(p, 1-p) is below this less often (0: visit all)", false, 0, "double");
+        adaptive_scan_min = new TCLAP::ValueArg<double>("", "adaptive_scan_min", "lowest visit probability for --adaptive_scan", false, 0.1, "double");
+        minibatch_fraction = new TCLAP::ValueArg<double>("", "minibatch_fraction", "fraction of the evidence variables sampled in each learning epoch", false, 1.0, "double");
+        minibatch_size = new TCLAP::ValueArg<long>("", "minibatch_size", "number of evidence variables sampled in each learning epoch, overrides --minibatch_fraction (0: use the fraction)", false, 0, "long");
+        learn_tolerance = new TCLAP::ValueArg<double>("", "learn_tolerance", "stop learning once lmax, or the held-out loss gain, stays below this for --learn_patience epochs (0: never)", false, 0, "double");
+        learn_patience = new TCLAP::ValueArg<int>("", "learn_patience", "epochs without progress before learning stops", false, 3, "int");
+        holdout_fraction = new TCLAP::ValueArg<double>("", "holdout_fraction", "fraction of the evidence held out of learning to score weights by pseudo-likelihood; keeps the best weights", false, 0, "double");
+        hot_weight_threshold = new TCLAP::ValueArg<long>("", "hot_weight_threshold", "in learning, weights with at least this many factors accumulate their gradients in each thread and apply them in batches (0: never)", false, 0, "long");
+        optimizer = new TCLAP::ValueArg<std::string>("", "optimizer", "per-weight learning update rule: sgd, adagrad, rmsprop, adam", false, "sgd", "string");
+        n_chains = new TCLAP::ValueArg<int>("", "n_chains", "number of chains each thread advances together in inference, Boolean-only graphs", false, 1, "int");
+        prefetch_distance = new TCLAP::ValueArg<int>("", "prefetch_distance", "prefetch the factors and neighbour values of the variables this many positions ahead of the sampler (0: never)", false, 0, "int");
+        hub_threshold = new TCLAP::ValueArg<long>("", "hub_threshold", "in inference, sample Boolean variables with at least this many factors in a separate phase, summing their potentials with all threads of the node (0: never)", false, 0, "long");
+        n_temperatures = new TCLAP::ValueArg<int>("", "n_temperatures", "in inference, run this many factor graph copies at temperatures from 1 to --max_temperature and exchange their assignments (parallel tempering); only the copy at temperature 1 is sampled from", false, 1, "int");
+        max_temperature = new TCLAP::ValueArg<double>("", "max_temperature", "highest temperature for --n_temperatures", false, 10.0, "double");
+        swap_interval = new TCLAP::ValueArg<int>("", "swap_interval", "epochs between exchange proposals for --n_temperatures", false, 1, "int");
+        cluster_interval = new TCLAP::ValueArg<int>("", "cluster_interval", "in inference, follow every this many sweeps with a Swendsen-Wang move over the clusters of positively weighted EQUAL factors, Boolean-only graphs (0: never)", false, 0, "int");
+        inference_engine = new TCLAP::ValueArg<std::string>("", "inference_engine", "inference engine of gibbs: gibbs, or meanfield for damped mean-field marginals in at most -i iterations", false, "gibbs", "string");
+        damping = new TCLAP::ValueArg<double>("", "damping", "weight of the old distributions in each mean-field update, in [0, 1)", false, 0.5, "double");
+        mean_field_warm_start = new TCLAP::ValueArg<int>("", "mean_field_warm_start", "start gibbs inference from a draw of this many mean-field iterations (0: never)", false, 0, "int");
+        exact_threshold = new TCLAP::ValueArg<long>("", "exact_threshold", "in inference, solve connected components of at most this many sampled variables exactly instead of sampling them (0: never)", false, 0, "long");
+        component_schedule = new TCLAP::SwitchArg("", "component_schedule", "in inference, schedule variables by connected component, and stop sampling components that meet --inference_tolerance/--rhat_threshold", false);
+        anneal_start_temperature = new TCLAP::ValueArg<double>("", "anneal_start_temperature", "temperature of the first annealing epoch of map", false, 10.0, "double");
+        anneal_end_temperature = new TCLAP::ValueArg<double>("", "anneal_end_temperature", "temperature of the last annealing epoch of map", false, 0.05, "double");
+        huge_pages = new TCLAP::ValueArg<std::string>("", "huge_pages", "back large arrays with huge pages: none, thp, 2m, 1g", false, "none", "string");
+        prefault = new TCLAP::SwitchArg("", "prefault", "prefault large arrays in parallel on their NUMA node", false);
 
         cmd->add(*fg_file);
         
@@ -71,9 +103,41 @@ namespace dd{
         cmd->add(*sample_evidence);
         cmd->add(*learn_non_evidence);
         cmd->add(*check_convergence);
+        cmd->add(*boolean_bitpack);
+        cmd->add(*simplify_inference);
+        cmd->add(*fold_unary);
+        cmd->add(*dedupe_factors);
+        cmd->add(*rao_blackwell);
+        cmd->add(*inference_tolerance);
+        cmd->add(*rhat_threshold);
+        cmd->add(*adaptive_scan);
+        cmd->add(*adaptive_scan_min);
+        cmd->add(*minibatch_fraction);
+        cmd->add(*minibatch_size);
+        cmd->add(*learn_tolerance);
+        cmd->add(*learn_patience);
+        cmd->add(*holdout_fraction);
+        cmd->add(*hot_weight_threshold);
+        cmd->add(*optimizer);
+        cmd->add(*n_chains);
+        cmd->add(*prefetch_distance);
+        cmd->add(*hub_threshold);
+        cmd->add(*n_temperatures);
+        cmd->add(*max_temperature);
+        cmd->add(*swap_interval);
+        cmd->add(*cluster_interval);
+        cmd->add(*inference_engine);
+        cmd->add(*damping);
+        cmd->add(*mean_field_warm_start);
+        cmd->add(*exact_threshold);
+        cmd->add(*component_schedule);
+        cmd->add(*anneal_start_temperature);
+        cmd->add(*anneal_end_temperature);
+        cmd->add(*huge_pages);
+        cmd->add(*prefault);
       }else{
         std::cout << "ERROR: UNKNOWN APP NAME " << app_name << std::endl;
-        std::cout << "AVAILABLE APP {gibbs}" << app_name << std::endl;
+        std::cout << "AVAILABLE APP {gibbs, em, map}" << app_name << std::endl;
         assert(false);
       }
     }
@@ -46,6 +46,38 @@ namespace dd{
     TCLAP::SwitchArg * sample_evidence;
     TCLAP::SwitchArg * learn_non_evidence;
     TCLAP::SwitchArg * check_convergence;
+    TCLAP::SwitchArg * boolean_bitpack;
+    TCLAP::SwitchArg * simplify_inference;
+    TCLAP::SwitchArg * fold_unary;
+    TCLAP::SwitchArg * dedupe_factors;
+    TCLAP::SwitchArg * rao_blackwell;
+    TCLAP::ValueArg<double> * inference_tolerance;
+    TCLAP::ValueArg<double> * rhat_threshold;
+    TCLAP::ValueArg<double> * adaptive_scan;
+    TCLAP::ValueArg<double> * adaptive_scan_min;
+    TCLAP::ValueArg<double> * minibatch_fraction;
+    TCLAP::ValueArg<long> * minibatch_size;
+    TCLAP::ValueArg<double> * learn_tolerance;
+    TCLAP::ValueArg<int> * learn_patience;
+    TCLAP::ValueArg<double> * holdout_fraction;
+    TCLAP::ValueArg<long> * hot_weight_threshold;
+    TCLAP::ValueArg<std::string> * optimizer;
+    TCLAP::ValueArg<int> * n_chains;
+    TCLAP::ValueArg<int> * prefetch_distance;
+    TCLAP::ValueArg<long> * hub_threshold;
+    TCLAP::ValueArg<int> * n_temperatures;
+    TCLAP::ValueArg<double> * max_temperature;
+    TCLAP::ValueArg<int> * swap_interval;
+    TCLAP::ValueArg<int> * cluster_interval;
+    TCLAP::ValueArg<std::string> * inference_engine;
+    TCLAP::ValueArg<double> * damping;
+    TCLAP::ValueArg<int> * mean_field_warm_start;
+    TCLAP::ValueArg<long> * exact_threshold;
+    TCLAP::SwitchArg * component_schedule;
+    TCLAP::ValueArg<double> * anneal_start_temperature;
+    TCLAP::ValueArg<double> * anneal_end_temperature;
+    TCLAP::ValueArg<std::string> * huge_pages;
+    TCLAP::SwitchArg * prefault;
 
     // EM arguments
     TCLAP::ValueArg<int> * n_iter;
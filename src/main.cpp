@@ -10,6 +10,8 @@ int main(int argv, char** argc){
     gibbs(cmd_parser);
   } else if (cmd_parser.app_name == "em") {
       em(cmd_parser);
+  } else if (cmd_parser.app_name == "map") {
+    map_inference(cmd_parser);
   }
 
 }
@@ -186,3 +186,55 @@ TEST(FactorTest, THREE_VAR_IMPLY) {
 	EXPECT_NEAR(f._potential_logical(vifs, values, vid, propose), 1.0, EQ_TOL);
 
 }
+
+// bit-packed evaluation must agree with evaluation over the plain array
+TEST(FactorTest, BITPACKED_FACTORS) {
+
+	const int funcs[5] = {FUNC_AND, FUNC_ISTRUE, FUNC_OR, FUNC_EQUAL, FUNC_IMPLY_neg1_1};
+	VariableInFactor vifs[3];
+	VariableValue values[3];
+	BitAssignment bits(3);
+
+	for (int i = 0; i < 3; i++) {
+		vifs[i].vid = i;
+		vifs[i].equal_to = 1;
+	}
+	vifs[0].is_positive = true;
+	vifs[1].is_positive = false;
+	vifs[2].is_positive = true;
+
+	CompactFactor f;
+	f.n_variables = 3;
+	f.n_start_i_vif = 0;
+
+	for (int world = 0; world < 8; world++) {
+		for (int i = 0; i < 3; i++) {
+			values[i] = (world >> i) & 1;
+		}
+		bits.pack(values);
+		for (int i = 0; i < 3; i++) {
+			EXPECT_EQ(bits[i], values[i]);
+		}
+		for (int k = 0; k < 5; k++) {
+			f.func_id = funcs[k];
+			for (VariableValue propose = 0; propose <= 1; propose++) {
+				EXPECT_NEAR(f.potential(vifs, bits, 2, propose),
+					f.potential(vifs, values, 2, propose), EQ_TOL);
+			}
+			EXPECT_NEAR(f.potential(vifs, bits, -1, -1), f.potential(vifs, values, -1, -1), EQ_TOL);
+		}
+	}
+
+	bits.set(1, 1);
+	bits.set(0, 0);
+	EXPECT_EQ(bits[1], 1);
+	EXPECT_EQ(bits[0], 0);
+
+	// plain stores, for a single writer per word
+	bits.is_shared = false;
+	bits.set(1, 0);
+	bits.set(2, 1);
+	bits.set(2, 1);
+	EXPECT_EQ(bits[1], 0);
+	EXPECT_EQ(bits[2], 1);
+}
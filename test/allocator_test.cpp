@@ -0,0 +1,78 @@
+/**
+ * Unit tests for the allocator of the large factor graph arrays
+ */
+
+#include "gtest/gtest.h"
+#include "dstruct/allocator.h"
+#include <sstream>
+
+// test for parsing policy names
+TEST(AllocatorTest, parse_alloc_policy) {
+	int policy = -1;
+	EXPECT_TRUE(dd::parse_alloc_policy("none", policy));
+	EXPECT_EQ(policy, dd::ALLOC_DEFAULT);
+	EXPECT_TRUE(dd::parse_alloc_policy("", policy));
+	EXPECT_EQ(policy, dd::ALLOC_DEFAULT);
+	EXPECT_TRUE(dd::parse_alloc_policy("thp", policy));
+	EXPECT_EQ(policy, dd::ALLOC_THP);
+	EXPECT_TRUE(dd::parse_alloc_policy("2m", policy));
+	EXPECT_EQ(policy, dd::ALLOC_HUGE_2MB);
+	EXPECT_TRUE(dd::parse_alloc_policy("1g", policy));
+	EXPECT_EQ(policy, dd::ALLOC_HUGE_1GB);
+	EXPECT_FALSE(dd::parse_alloc_policy("4k", policy));
+}
+
+// test that arrays under every policy are usable, and get the policy or one
+// it falls back to: explicit huge pages need reserved pages, so they may
+// fall back to transparent huge pages, and those to none
+TEST(AllocatorTest, alloc_array) {
+	const int policies[4] = {dd::ALLOC_DEFAULT, dd::ALLOC_THP, dd::ALLOC_HUGE_2MB, dd::ALLOC_HUGE_1GB};
+	const long n = 3L << 20;
+	for (int k = 0; k < 4; k++) {
+		dd::set_alloc_policy(policies[k], k % 2 == 1);
+		long * large = dd::alloc_array<long>(n, "large");
+		int * small = dd::alloc_array<int>(16, "small");
+
+		const int policy = dd::get_alloc_policy(large);
+		EXPECT_TRUE(policy == policies[k] || policy == dd::ALLOC_THP || policy == dd::ALLOC_DEFAULT);
+		EXPECT_LE(policy, policies[k]);
+		// arrays smaller than a huge page use malloc
+		EXPECT_EQ(dd::get_alloc_policy(small), dd::ALLOC_DEFAULT);
+
+		for (long i = 0; i < n; i++) {
+			large[i] = i;
+		}
+		EXPECT_EQ(large[n - 1], n - 1);
+
+		dd::free_array(large);
+		dd::free_array(small);
+		EXPECT_EQ(dd::get_alloc_policy(large), -1);
+	}
+	dd::set_alloc_policy(dd::ALLOC_DEFAULT, false);
+}
+
+// test that the report lists each live array once, with the totals
+TEST(AllocatorTest, print_alloc_report) {
+	dd::set_alloc_policy(dd::ALLOC_THP, false);
+	char * a = dd::alloc_array<char>(4L << 20, "report_a");
+	char * b = dd::alloc_array<char>(4L << 20, "report_b");
+	dd::set_alloc_policy(dd::ALLOC_DEFAULT, false);
+
+	std::ostringstream out;
+	dd::print_alloc_report(out);
+	const std::string report = out.str();
+	EXPECT_NE(report.find("report_a"), std::string::npos);
+	EXPECT_NE(report.find("report_b"), std::string::npos);
+	EXPECT_NE(report.find("TOTAL"), std::string::npos);
+	if (dd::get_alloc_policy(a) == dd::ALLOC_THP && dd::get_alloc_policy(b) == dd::ALLOC_THP) {
+		EXPECT_NE(report.find("report_a [thp] 4194304 bytes"), std::string::npos);
+		EXPECT_NE(report.find("8388608 in thp arrays"), std::string::npos);
+		EXPECT_NE(report.find("THP-BACKED BYTES OF THE VMAS"), std::string::npos);
+	}
+
+	dd::free_array(a);
+	dd::free_array(b);
+	std::ostringstream after;
+	dd::print_alloc_report(after);
+	EXPECT_EQ(after.str().find("report_a"), std::string::npos);
+}
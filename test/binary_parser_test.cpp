@@ -30,8 +30,8 @@ TEST(BinaryParserTest, read_variables) {
 	EXPECT_EQ(fg.variables[1].is_evid, true);
 	EXPECT_EQ(fg.variables[1].lower_bound, 0);
 	EXPECT_EQ(fg.variables[1].upper_bound, 1);
-	EXPECT_EQ(fg.variables[1].assignment_evid, 1);
-	EXPECT_EQ(fg.variables[1].assignment_free, 1);
+	EXPECT_EQ(fg.infrs->assignments_evid[1], 1);
+	EXPECT_EQ(fg.infrs->assignments_free[1], 1);
 }
 
 // test read_factors
@@ -0,0 +1,42 @@
+/**
+ * Unit tests for exact inference of small components
+ */
+
+#include "gtest/gtest.h"
+#include "dstruct/factor_graph/factor_graph.h"
+#include "app/gibbs/exact_inference.h"
+#include "app/gibbs/variable_schedule.h"
+#include "test_graphs.h"
+#include <math.h>
+
+// test exact inference of the component {v0, v1}, cut off by the evidence
+// v2 from the component {v3}, against the sum over its four assignments
+TEST(ExactInferenceTest, solve) {
+	dd::FactorGraph fg(4, 4, 3, 7);
+	build_test_graph(fg, {false, false, true, false}, {1.0, 2.0, -0.5}, {
+		{dd::FUNC_ISTRUE, 0, {0}}, {dd::FUNC_EQUAL, 1, {0, 1}},
+		{dd::FUNC_EQUAL, 2, {1, 2}}, {dd::FUNC_EQUAL, 2, {2, 3}}}, {0, 0, 1, 0});
+
+	dd::VariableSchedule schedule;
+	schedule.build_inference(fg, false, 1);
+	schedule.split_exact(fg, 2, 1L << 16, 1);
+	EXPECT_TRUE(schedule.vids.empty());
+	EXPECT_EQ(schedule.exact_bounds, std::vector<long>({0, 2, 3}));
+
+	dd::ExactInference exact(&fg);
+	exact.solve(schedule);
+	EXPECT_EQ(exact.n_configs, 6);
+	for (long i = 0; i < 4; i++) EXPECT_EQ(fg.infrs->assignments_evid[i], i == 2);
+
+	// unnormalized probabilities of (v0, v1), with v2 = 1
+	double p[2][2];
+	for (int a = 0; a < 2; a++) {
+		for (int b = 0; b < 2; b++) {
+			p[a][b] = exp(1.0 * a + 2.0 * (a == b) - 0.5 * (b == 1));
+		}
+	}
+	const double z = p[0][0] + p[0][1] + p[1][0] + p[1][1];
+	EXPECT_NEAR(exact.q[exact.q_start[0] + 1], (p[1][0] + p[1][1]) / z, 1e-9);
+	EXPECT_NEAR(exact.q[exact.q_start[1] + 1], (p[0][1] + p[1][1]) / z, 1e-9);
+	EXPECT_NEAR(exact.q[exact.q_start[3] + 1], exp(-0.5) / (1 + exp(-0.5)), 1e-9);
+}
@@ -8,6 +8,7 @@
 #include "dstruct/factor_graph/factor_graph.h"
 #include "gibbs.h"
 #include <fstream>
+#include <sstream>
 
 using namespace dd;
 
@@ -67,3 +68,109 @@ TEST_F(FactorGraphTest, update_weight) {
 
 }
 
+
+// test update_weight function with adaptive optimizers
+TEST_F(FactorGraphTest, update_weight_optimizer) {
+	fg.stepsize = 0.1;
+	fg.update<true>(fg.variables[0], 0);
+
+	// AdaGrad steps shrink with the sum of the squared gradients
+	fg.infrs->enable_optimizer(OPT_ADAGRAD);
+	fg.update_weight(fg.variables[0]);
+	EXPECT_NEAR(fg.infrs->weight_values[0], 0.1, 1e-6);
+	fg.update_weight(fg.variables[0]);
+	EXPECT_NEAR(fg.infrs->weight_values[0], 0.1 + 0.1 / sqrt(2), 1e-6);
+
+	// the first bias-corrected Adam step is the stepsize
+	fg.infrs->weight_values[0] = 0;
+	fg.infrs->enable_optimizer(OPT_ADAM);
+	fg.update_weight(fg.variables[0]);
+	EXPECT_NEAR(fg.infrs->weight_values[0], 0.1, 1e-6);
+
+	// Adam as in the paper, corrected by the number t of updates of the
+	// weight, however many epochs they span
+	fg.infrs->weight_values[0] = 0;
+	fg.infrs->enable_optimizer(OPT_ADAM);
+	const double gs[4] = {2, 0.5, -2, 1};
+	double w = 0, m = 0, v = 0;
+	for (int t = 1; t <= 4; t++) {
+		const double g = gs[t - 1];
+		m = 0.9 * m + 0.1 * g;
+		v = 0.999 * v + 0.001 * g * g;
+		const double m_hat = m / (1 - pow(0.9, t));
+		const double v_hat = v / (1 - pow(0.999, t));
+		w += 0.1 * m_hat / (sqrt(v_hat) + 1e-8);
+		fg.infrs->apply_gradient(0, 0.1, g);
+		EXPECT_NEAR(fg.infrs->weight_values[0], w, 1e-9);
+	}
+
+	int optimizer;
+	EXPECT_TRUE(parse_optimizer("rmsprop", optimizer));
+	EXPECT_EQ(optimizer, OPT_RMSPROP);
+	EXPECT_FALSE(parse_optimizer("newton", optimizer));
+}
+
+// test neg_ps_loglikelihood function
+TEST_F(FactorGraphTest, neg_ps_loglikelihood) {
+	std::vector<long> vids;
+	vids.push_back(0);
+	vids.push_back(8);
+
+	// both values are equally likely with weight 0
+	EXPECT_NEAR(fg.neg_ps_loglikelihood(vids), 2 * log(2), 1e-9);
+
+	// variable 0 is positive, variable 8 negative
+	fg.infrs->weight_values[0] = 1;
+	EXPECT_NEAR(fg.neg_ps_loglikelihood(vids), log(1 + exp(-1)) + log(1 + exp(1)), 1e-9);
+}
+
+// test log_potential function and exchanging assignments
+TEST_F(FactorGraphTest, log_potential) {
+	std::vector<long> vids;
+	vids.push_back(0);
+	vids.push_back(8);
+	fg.infrs->weight_values[0] = 1;
+	// variable 0 is positive, variable 8 negative
+	EXPECT_DOUBLE_EQ(fg.log_potential(vids), 1.0);
+	fg.inverse_temperature = 0.5;
+	EXPECT_DOUBLE_EQ(fg.log_potential(vids), 0.5);
+
+	InferenceResult other(18, 1);
+	for (int i = 0; i < 18; i++) other.assignments_evid[i] = 1;
+	fg.infrs->swap_assignments(other);
+	EXPECT_EQ(other.assignments_evid[0], 1);
+	EXPECT_EQ(other.assignments_evid[8], 0);
+	EXPECT_DOUBLE_EQ(fg.log_potential(vids), 1.0);
+}
+
+// test update_weight function with captured factor values
+TEST_F(FactorGraphTest, update_weight_factor_values) {
+	fg.stepsize = 0.1;
+	fg.infrs->weight_values[0] = 0.5;
+	fg.update<true>(fg.variables[0], 0);
+
+	FactorValues evid, free;
+	fg.factor_values<false>(fg.variables[0], evid);
+	fg.factor_values<true>(fg.variables[0], free);
+	EXPECT_EQ(evid.potentials[1], fg.potential<false>(fg.variables[0], 1));
+	EXPECT_EQ(free.potentials[0], fg.potential<true>(fg.variables[0], 0));
+
+	// same update as the one evaluating the factors again
+	fg.update_weight(fg.variables[0], evid, free);
+	const double fused = fg.infrs->weight_values[0];
+	fg.infrs->weight_values[0] = 0.5;
+	fg.update_weight(fg.variables[0]);
+	EXPECT_EQ(fused, fg.infrs->weight_values[0]);
+	EXPECT_EQ(fused, 0.6);
+}
+
+// test print_memory_usage function
+// the optimizer state counts towards the total, 32 bytes per weight for Adam
+TEST_F(FactorGraphTest, print_memory_usage_optimizer) {
+	std::ostringstream out;
+	const long sgd = fg.print_memory_usage(out, "SGD");
+	fg.infrs->enable_optimizer(OPT_ADAM);
+	const long adam = fg.print_memory_usage(out, "ADAM");
+	EXPECT_EQ(adam - sgd, 4 * (long)sizeof(double) * fg.n_weight);
+	EXPECT_NE(out.str().find("weight_beta2_t"), std::string::npos);
+}
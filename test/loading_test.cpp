@@ -8,6 +8,7 @@
 #include "dstruct/factor_graph/factor_graph.h"
 #include "gibbs.h"
 #include <fstream>
+#include <map>
 
 using namespace dd;
 
@@ -67,6 +68,25 @@ TEST_F(LoadingTest, organize_graph_by_edge) {
 	fg.safety_check();
 }
 
+// each variable's region of the edge-based store lists the factors it is in
+TEST_F(LoadingTest, variable_factor_regions) {
+	long n_edges = 0;
+	for (int i = 0; i < fg.n_var; i++) {
+		const Variable & variable = fg.variables[i];
+		EXPECT_EQ(variable.n_start_i_factors, n_edges);
+		for (int j = 0; j < variable.n_factors; j++) {
+			const CompactFactor & factor = fg.compact_factors[variable.n_start_i_factors + j];
+			bool found = false;
+			for (int k = 0; k < factor.n_variables; k++) {
+				found |= fg.vifs[factor.n_start_i_vif + k].vid == variable.id;
+			}
+			EXPECT_TRUE(found);
+		}
+		n_edges += variable.n_factors;
+	}
+	EXPECT_EQ(n_edges, fg.c_edge);
+}
+
 // test for FactorGraph::copy_from function
 TEST_F(LoadingTest, copy_from) {
 	fg.sort_by_id();
@@ -78,3 +98,214 @@ TEST_F(LoadingTest, copy_from) {
 	EXPECT_TRUE(memcmp(&fg, &fg2, sizeof(fg)));
 }
 
+
+// test for FactorGraph::release_load_only function
+TEST_F(LoadingTest, release_load_only) {
+	fg.sort_by_id();
+	fg.organize_graph_by_edge();
+	fg.release_load_only();
+	EXPECT_TRUE(fg.factors == NULL);
+	EXPECT_TRUE(fg.weights == NULL);
+
+	// a copy of a released factor graph keeps the weights and the edges
+	dd::FactorGraph fg2(18, 18, 1, 18);
+	fg2.copy_from(&fg);
+	EXPECT_TRUE(fg2.factors == NULL);
+	EXPECT_EQ(fg2.infrs->weight_values[0], fg.infrs->weight_values[0]);
+	EXPECT_EQ(fg2.infrs->weights_isfixed[0], fg.infrs->weights_isfixed[0]);
+	EXPECT_EQ(0, memcmp(fg2.vifs, fg.vifs, sizeof(dd::VariableInFactor) * 18));
+}
+
+// test for FactorGraph::build_inference_view function
+// the factors of the 9 evidence variables are constant, and are dropped
+TEST_F(LoadingTest, build_inference_view) {
+	fg.build_inference_view(false, false);
+	EXPECT_EQ(fg.n_inf_edge, 9);
+
+	fg.use_inference_view(true);
+	for (int i = 0; i < 18; i++) {
+		EXPECT_EQ(fg.variables[i].n_factors, i < 9 ? 0 : 1);
+	}
+	EXPECT_EQ(fg.vifs[fg.compact_factors[fg.variables[9].n_start_i_factors].n_start_i_vif].vid, 9);
+
+	fg.use_inference_view(false);
+	for (int i = 0; i < 18; i++) {
+		EXPECT_EQ(fg.variables[i].n_factors, 1);
+	}
+}
+
+// test for unary factor folding
+// all the factors of the biased coin are unary, so all of them are folded
+TEST_F(LoadingTest, fold_unary) {
+	double potential_pos = fg.potential<false>(fg.variables[0], 1);
+	double potential_neg = fg.potential<false>(fg.variables[0], 0);
+
+	fg.fold_unary = true;
+	fg.organize_graph_by_edge();
+	EXPECT_EQ(fg.n_unary, 18);
+	for (int i = 0; i < 18; i++) {
+		EXPECT_EQ(fg.variables[i].n_factors, 0);
+	}
+	EXPECT_EQ(fg.potential<false>(fg.variables[0], 1), potential_pos);
+	EXPECT_EQ(fg.potential<false>(fg.variables[0], 0), potential_neg);
+
+	fg.infrs->weight_values[0] = 2.0;
+	fg.update_unary_bias();
+	EXPECT_EQ(fg.potential<false>(fg.variables[0], 1) - fg.potential<false>(fg.variables[0], 0), 2.0);
+}
+
+// test for duplicate factor merging
+TEST_F(LoadingTest, dedupe_factors) {
+	fg.organize_graph_by_edge();
+	double potential_pos = fg.potential<false>(fg.variables[0], 1);
+
+	// make factor 1 a copy of factor 0
+	fg.factors[1].tmp_variables = fg.factors[0].tmp_variables;
+	fg.dedupe_factors = true;
+	fg.organize_graph_by_edge();
+	EXPECT_EQ(fg.n_merged, 1);
+	EXPECT_EQ(fg.factors[0].multiplicity, 2);
+	EXPECT_EQ(fg.factors[1].multiplicity, 0);
+	EXPECT_EQ(fg.variables[0].n_factors, 1);
+	EXPECT_EQ(fg.variables[1].n_factors, 0);
+	EXPECT_EQ(fg.compact_factors_multiplicities[fg.variables[0].n_start_i_factors], 2);
+	EXPECT_EQ(fg.potential<false>(fg.variables[0], 1), 2 * potential_pos);
+}
+
+// test for the hot weights and their gradients
+// the single weight of the biased coin has 18 factors
+TEST_F(LoadingTest, find_hot_weights) {
+	fg.hot_weight_threshold = 10;
+	fg.find_hot_weights();
+	EXPECT_EQ(fg.n_hot_weights, 1);
+	EXPECT_EQ(fg.hot_weight_slots[0], 0);
+
+	// the gradient of variable 0 is held until flushed
+	HotGradients hot;
+	fg.init_hot_gradients(hot);
+	fg.stepsize = 0.1;
+	fg.update<true>(fg.variables[0], 0);
+	FactorValues evid, free;
+	fg.factor_values<false>(fg.variables[0], evid);
+	fg.factor_values<true>(fg.variables[0], free);
+	fg.update_weight(fg.variables[0], evid, free, &hot);
+	EXPECT_EQ(fg.infrs->weight_values[0], 0);
+	EXPECT_EQ(hot.grads[0], 1);
+	fg.flush_hot_gradients(hot);
+	EXPECT_EQ(fg.infrs->weight_values[0], 0.1);
+	EXPECT_EQ(hot.grads[0], 0);
+}
+
+// test that hot weights count factors, not edges: the weight of three
+// binary factors, with six edges
+TEST(HotWeightsTest, count_factors) {
+	dd::FactorGraph fg(4, 3, 1, 6);
+	for (long i = 0; i < 4; i++) {
+		fg.variables[i] = dd::Variable(i, DTYPE_BOOLEAN, false, 0, 1, 0, false);
+	}
+	fg.weights[0] = dd::Weight(0, 1.0, false);
+	for (long i = 0; i < 3; i++) {
+		fg.factors[i] = dd::Factor(i, 0, dd::FUNC_EQUAL, 2);
+		fg.factors[i].tmp_variables.push_back(dd::VariableInFactor(i, 1, i, 0, true));
+		fg.factors[i].tmp_variables.push_back(dd::VariableInFactor(i+1, 1, i+1, 1, true));
+	}
+	fg.c_nvar = 4;
+	fg.c_nfactor = 3;
+	fg.c_nweight = 1;
+	fg.sort_by_id();
+	fg.organize_graph_by_edge();
+
+	fg.hot_weight_threshold = 4;
+	fg.find_hot_weights();
+	EXPECT_EQ(fg.n_hot_weights, 0);
+	EXPECT_EQ(fg.hot_weight_slots[0], -1);
+
+	dd::FactorGraph copy(4, 3, 1, 6);
+	copy.copy_from(&fg);
+	copy.hot_weight_threshold = 3;
+	copy.find_hot_weights();
+	EXPECT_EQ(copy.n_hot_weights, 1);
+}
+
+// test for partial evaluation in the inference view, on v0, v1 and v2 free
+// and v3 = 1, v4 = 0 evidence:
+//   f0 AND(v0, v4)         unsatisfied fixed member, dropped
+//   f1 OR(v1, v3)          satisfied fixed member, dropped
+//   f2 EQUAL(v0, v1, v3)   AND(v0, v1)
+//   f3 EQUAL(v1, !v2, v4)  AND(!v1, v2), the fixed member is unsatisfied
+//   f4 ISTRUE(v2, v3)      ISTRUE(v2)
+//   f5 OR(v0, v2)          kept as it is
+TEST(InferenceViewTest, build_inference_view) {
+	dd::FactorGraph fg(5, 6, 6, 14);
+	for (long i = 0; i < 5; i++) {
+		fg.variables[i] = dd::Variable(i, DTYPE_BOOLEAN, i >= 3, 0, 1, 0, false);
+	}
+	for (long i = 0; i < 6; i++) {
+		fg.weights[i] = dd::Weight(i, 0.5 * (i + 1), false);
+	}
+	const int funcs[6] = {FUNC_AND, FUNC_OR, FUNC_EQUAL, FUNC_EQUAL, FUNC_ISTRUE, FUNC_OR};
+	const long members[6][3] = {{0, 4, -1}, {1, 3, -1}, {0, 1, 3}, {1, 2, 4}, {2, 3, -1}, {0, 2, -1}};
+	for (long i = 0; i < 6; i++) {
+		const int n = members[i][2] < 0 ? 2 : 3;
+		fg.factors[i] = dd::Factor(i, i, funcs[i], n);
+		for (int j = 0; j < n; j++) {
+			const bool is_positive = !(i == 3 && members[i][j] == 2);
+			fg.factors[i].tmp_variables.push_back(dd::VariableInFactor(members[i][j], j, is_positive));
+		}
+	}
+	fg.c_nvar = 5;
+	fg.c_nfactor = 6;
+	fg.c_nweight = 6;
+	fg.sort_by_id();
+	fg.organize_graph_by_edge();
+	fg.safety_check();
+	fg.infrs->assignments_evid[3] = 1;
+	fg.infrs->assignments_evid[4] = 0;
+
+	fg.build_inference_view(false, true);
+	EXPECT_EQ(fg.n_inf_edge, 7);
+	EXPECT_EQ(fg.inf_n_factors[3], 0);
+	EXPECT_EQ(fg.inf_n_factors[4], 0);
+
+	// the kept factors by id, with their variables
+	std::map<long, std::vector<dd::VariableInFactor> > kept;
+	std::map<long, int> kept_funcs;
+	for (long i = 0; i < fg.n_inf_edge; i++) {
+		const dd::CompactFactor & cf = fg.inf_compact_factors[i];
+		kept_funcs[cf.id] = cf.func_id;
+		kept[cf.id] = std::vector<dd::VariableInFactor>(fg.inf_vifs + cf.n_start_i_vif,
+			fg.inf_vifs + cf.n_start_i_vif + cf.n_variables);
+	}
+	EXPECT_EQ(kept.count(0), 0u);
+	EXPECT_EQ(kept.count(1), 0u);
+	EXPECT_EQ(kept_funcs[2], FUNC_AND);
+	ASSERT_EQ(kept[2].size(), 2u);
+	EXPECT_TRUE(kept[2][0].is_positive);
+	EXPECT_TRUE(kept[2][1].is_positive);
+	EXPECT_EQ(kept_funcs[3], FUNC_AND);
+	ASSERT_EQ(kept[3].size(), 2u);
+	EXPECT_EQ(kept[3][0].vid, 1);
+	EXPECT_FALSE(kept[3][0].is_positive);
+	EXPECT_EQ(kept[3][1].vid, 2);
+	EXPECT_TRUE(kept[3][1].is_positive);
+	EXPECT_EQ(kept_funcs[4], FUNC_ISTRUE);
+	EXPECT_EQ(kept[4].size(), 1u);
+	EXPECT_EQ(kept_funcs[5], FUNC_OR);
+	EXPECT_EQ(kept[5].size(), 2u);
+
+	// the view only drops terms that do not depend on the free variable, so
+	// the difference of the potentials of its two values is unchanged
+	for (int world = 0; world < 8; world++) {
+		for (long i = 0; i < 3; i++) {
+			fg.infrs->assignments_evid[i] = (world >> i) & 1;
+		}
+		for (long i = 0; i < 3; i++) {
+			const double diff = fg.potential<false>(fg.variables[i], 1) - 
+				fg.potential<false>(fg.variables[i], 0);
+			fg.use_inference_view(true);
+			EXPECT_NEAR(fg.potential<false>(fg.variables[i], 1) - 
+				fg.potential<false>(fg.variables[i], 0), diff, 1e-9);
+			fg.use_inference_view(false);
+		}
+	}
+}
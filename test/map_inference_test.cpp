@@ -0,0 +1,97 @@
+/**
+ * Unit tests for MAP inference
+ */
+
+#include "gtest/gtest.h"
+#include "dstruct/factor_graph/factor_graph.h"
+#include "app/map/map_inference.h"
+#include "gibbs.h"
+#include "test_graphs.h"
+#include <fstream>
+#include <stdio.h>
+
+// the command line of the map app, on the output folder .
+static dd::CmdParser parse_map_input() {
+	const char* argv[23] = {
+		"dw", "map", "-w", "./test/coin/graph.weights", "-v", "./test/coin/graph.variables", 
+		"-f", "./test/coin/graph.factors", "-e", "./test/coin/graph.edges", "-m", "./test/coin/graph.meta",
+		"-o", ".", "-l", "0", "-i", "10", "-s", "1", "--alpha", "0.1", ""
+	};
+	return parse_input(23, (char **)argv);
+}
+
+// test fixture
+// three query variables tied by EQUAL factors of weight 1, with a prior of
+// weight 2 on v0: the optimum sets all of them, with log potential 4
+class MapInferenceTest : public testing::Test {
+protected:
+
+	dd::FactorGraph fg;
+	dd::CmdParser cmd_parser;
+
+	MapInferenceTest() : fg(dd::FactorGraph(3, 3, 2, 5)), cmd_parser(parse_map_input()) {}
+
+	virtual void SetUp() {
+		build_test_graph(fg, {false, false, false}, {1.0, 2.0}, {
+			{dd::FUNC_EQUAL, 0, {0, 1}}, {dd::FUNC_EQUAL, 0, {1, 2}},
+			{dd::FUNC_ISTRUE, 1, {0}}}, {0, 1, 0});
+	}
+
+};
+
+// test that ICM reaches the optimum from {0, 1, 0}: v0 follows its prior in
+// the first sweep, then v2 follows v1, and the second sweep changes nothing
+TEST_F(MapInferenceTest, icm) {
+	dd::GibbsSampling gibbs(&fg, &cmd_parser, 1, false, 0, false);
+	dd::MapInference map(&fg, &gibbs, 10, 0.1);
+	map.vids = std::vector<long>({0, 1, 2});
+
+	EXPECT_EQ(map.icm(fg, 100), 2);
+	for (long i = 0; i < 3; i++) {
+		EXPECT_EQ(fg.infrs->assignments_evid[i], 1);
+	}
+	EXPECT_NEAR(fg.log_potential(map.vids), 4.0, 1e-9);
+}
+
+// test that annealing ends at the optimum, and the dumped energy is the
+// negative log potential of the dumped assignment
+TEST_F(MapInferenceTest, anneal) {
+	dd::GibbsSampling gibbs(&fg, &cmd_parser, 1, false, 0, false);
+	dd::MapInference map(&fg, &gibbs, 10, 0.1);
+	map.anneal(10, true);
+
+	EXPECT_EQ(map.best_assignment, std::vector<dd::VariableValue>({1, 1, 1}));
+	EXPECT_NEAR(map.best_log_potential, 4.0, 1e-9);
+
+	map.dump(true);
+	std::ifstream fin_energy("./map_result.out.energy");
+	double energy;
+	fin_energy >> energy;
+	EXPECT_NEAR(energy, -map.best_log_potential, 1e-9);
+
+	std::ifstream fin_text("./map_result.out.text");
+	long vid;
+	dd::VariableValue value;
+	for (long i = 0; i < 3; i++) {
+		fin_text >> vid >> value;
+		EXPECT_EQ(vid, i);
+		EXPECT_EQ(value, 1);
+	}
+	remove("./map_result.out.energy");
+	remove("./map_result.out.text");
+}
+
+// test that annealing packed assignments with a schedule whose workers
+// share a word writes them atomically, whatever learning left behind
+TEST_F(MapInferenceTest, anneal_packed) {
+	fg.infrs->enable_bitpacking();
+	dd::GibbsSampling gibbs(&fg, &cmd_parser, 1, false, 0, false);
+	gibbs.n_thread_per_numa = 2;
+	gibbs.factorgraphs[0].infrs->share_bit_words(false);
+	dd::MapInference map(&fg, &gibbs, 10, 0.1);
+	map.anneal(10, true);
+
+	EXPECT_TRUE(gibbs.factorgraphs[0].infrs->assignments_evid_bits->is_shared);
+	EXPECT_EQ(map.best_assignment, std::vector<dd::VariableValue>({1, 1, 1}));
+	EXPECT_NEAR(map.best_log_potential, 4.0, 1e-9);
+}
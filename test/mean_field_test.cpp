@@ -0,0 +1,25 @@
+/**
+ * Unit tests for mean-field inference
+ */
+
+#include "gtest/gtest.h"
+#include "dstruct/factor_graph/factor_graph.h"
+#include "app/gibbs/mean_field.h"
+#include "test_graphs.h"
+#include <math.h>
+
+// test mean-field on a query variable with a prior and an EQUAL factor to
+// true evidence, where it is exact: P(v0 = 1) = sigmoid(1 + 0.5)
+TEST(MeanFieldTest, run) {
+	dd::FactorGraph fg(2, 2, 2, 3);
+	build_test_graph(fg, {false, true}, {1.0, 0.5}, {
+		{dd::FUNC_ISTRUE, 0, {0}}, {dd::FUNC_EQUAL, 1, {0, 1}}}, {0, 1});
+
+	dd::MeanField mf(&fg, false, 0.5, 1e-10);
+	mf.run(200, 1, true);
+	EXPECT_LT(mf.n_iterations, 200);
+	fg.infrs->agg_means[0] = fg.infrs->agg_nsamples[0] = 0;
+	mf.write_marginals(fg, *fg.infrs);
+	EXPECT_NEAR(fg.infrs->agg_means[0], 1.0 / (1.0 + exp(-1.5)), 1e-6);
+	EXPECT_EQ(fg.infrs->agg_nsamples[0], 1);
+}
@@ -7,7 +7,11 @@
 #include "gtest/gtest.h"
 #include "dstruct/factor_graph/factor_graph.h"
 #include "app/gibbs/single_thread_sampler.h"
+#include "app/gibbs/convergence_monitor.h"
+#include "app/gibbs/cluster_sampler.h"
+#include "app/gibbs/gibbs_sampling.h"
 #include "gibbs.h"
+#include "test_graphs.h"
 #include <fstream>
 
 // test fixture
@@ -75,3 +79,260 @@ TEST_F(SamplerTest, sample_single_variable) {
 	EXPECT_EQ(fg.infrs->assignments_evid[12], 1);
 }
 
+
+// test for sample_single_variable with the Rao-Blackwellized estimator
+// the conditional probability of 1 is accumulated instead of the sample
+TEST_F(SamplerTest, sample_single_variable_rao_blackwell) {
+	fg.infrs->rao_blackwell = true;
+	fg.infrs->weight_values[0] = 2;
+
+	sampler.sample_single_variable(10);
+	sampler.sample_single_variable(10);
+	EXPECT_DOUBLE_EQ(fg.infrs->agg_means[10], 2.0 / (1.0 + exp(-2.0)));
+	EXPECT_EQ(fg.infrs->agg_nsamples[10], 2);
+}
+
+// test for sample_single_variable with adaptive scan
+// samples of a variable visited with probability q are weighted by 1/q
+TEST_F(SamplerTest, sample_single_variable_adaptive_scan) {
+	fg.infrs->enable_adaptive_scan(0.2, 0.1);
+	EXPECT_EQ(fg.infrs->scan_prob(10), 1.0);
+
+	fg.infrs->scan_uncertainty[10] = 0.01;
+	EXPECT_DOUBLE_EQ(fg.infrs->scan_prob(10), 0.1);
+	sampler.sample_single_variable(10);
+	EXPECT_DOUBLE_EQ(fg.infrs->agg_nsamples[10], 10);
+
+	// the weight is 0, so the conditional probability of 1 is 0.5
+	EXPECT_FLOAT_EQ(fg.infrs->scan_uncertainty[10], 0.5 * (0.01 + 0.5));
+}
+
+// test for the R-hat of ConvergenceMonitor
+TEST(ConvergenceMonitorTest, rhat) {
+	double agreeing[2] = {0.7, 0.7};
+	EXPECT_LT(dd::ConvergenceMonitor::rhat(agreeing, 2, 100), 1.0);
+
+	double disagreeing[2] = {0.1, 0.9};
+	EXPECT_GT(dd::ConvergenceMonitor::rhat(disagreeing, 2, 100), 2.0);
+
+	double deterministic[2] = {1.0, 1.0};
+	EXPECT_EQ(dd::ConvergenceMonitor::rhat(deterministic, 2, 100), 1.0);
+}
+
+// test that split R-hat catches two replicas that agree on the marginal but
+// drift the same way, all 0s in the first half and all 1s in the second
+TEST_F(SamplerTest, convergence_monitor_split_rhat) {
+	std::vector<dd::FactorGraph> factorgraphs;
+	factorgraphs.push_back(fg);
+	dd::FactorGraph copy(18, 18, 1, 18);
+	copy.copy_from(&fg);
+	factorgraphs.push_back(copy);
+
+	dd::ConvergenceMonitor drifting(0, 1.1), stationary(0, 1.1);
+	for (int check = 1; check <= 2; check++) {
+		for (size_t j = 0; j < factorgraphs.size(); j++) {
+			for (long i = 0; i < fg.n_var; i++) {
+				factorgraphs[j].infrs->agg_nsamples[i] = 10 * check;
+				factorgraphs[j].infrs->agg_means[i] = 10 * (check - 1);
+			}
+		}
+		EXPECT_FALSE(drifting.check(factorgraphs, false));
+
+		for (size_t j = 0; j < factorgraphs.size(); j++) {
+			for (long i = 0; i < fg.n_var; i++) {
+				factorgraphs[j].infrs->agg_means[i] = 5 * check;
+			}
+		}
+		EXPECT_EQ(stationary.check(factorgraphs, false), check == 2);
+	}
+	EXPECT_GT(drifting.max_rhat, 2.0);
+	EXPECT_LT(stationary.max_rhat, 1.1);
+}
+
+// test that a tempered copy scales the log potentials by its inverse
+// temperature, and the acceptance of exchanging two tempered assignments
+TEST_F(SamplerTest, parallel_tempering) {
+	std::vector<long> vids;
+	for (long i = 0; i < fg.n_var; i++) {
+		vids.push_back(i);
+	}
+	const double pot = fg.potential<false>(fg.variables[0], 1);
+	const double log_pot = fg.log_potential(vids);
+	fg.inverse_temperature = 0.25;
+	EXPECT_NEAR(fg.potential<false>(fg.variables[0], 1), 0.25 * pot, 1e-9);
+	EXPECT_NEAR(fg.log_potential(vids), 0.25 * log_pot, 1e-9);
+	fg.inverse_temperature = 1.0;
+
+	// untempered log potentials 2 at temperature 1 and 6 at temperature 2:
+	// (1 - 0.5) * (6 - 2)
+	EXPECT_NEAR(dd::GibbsSampling::log_swap_acceptance(1.0, 0.5, 2.0, 3.0), 2.0, 1e-9);
+	EXPECT_NEAR(dd::GibbsSampling::log_swap_acceptance(1.0, 0.5, 6.0, 1.0), -2.0, 1e-9);
+	EXPECT_NEAR(dd::GibbsSampling::log_swap_acceptance(1.0, 1.0, 6.0, 1.0), 0.0, 1e-9);
+}
+
+// test for VariableSchedule
+// the coin graph has 9 evidence and 9 query variables
+TEST_F(SamplerTest, variable_schedule) {
+	dd::VariableSchedule schedule;
+
+	schedule.build_learning(fg, false, 4);
+	EXPECT_EQ(schedule.vids.size(), 9u);
+	for (size_t k = 0; k < schedule.vids.size(); k++) {
+		EXPECT_TRUE(fg.variables[schedule.vids[k]].is_evid);
+	}
+
+	schedule.build_inference(fg, false, 4);
+	EXPECT_EQ(schedule.vids.size(), 9u);
+	for (size_t k = 0; k < schedule.vids.size(); k++) {
+		EXPECT_FALSE(fg.variables[schedule.vids[k]].is_evid);
+	}
+
+	// the workers cover every scheduled variable
+	EXPECT_EQ(schedule.bounds.size(), 5u);
+	EXPECT_EQ(schedule.bounds[0], 0);
+	EXPECT_EQ(schedule.bounds[4], 9);
+	for (int i = 0; i < 4; i++) {
+		EXPECT_LE(schedule.bounds[i], schedule.bounds[i+1]);
+		EXPECT_GE(schedule.bounds[i+1] - schedule.bounds[i], 2);
+	}
+
+	schedule.build_inference(fg, true, 4);
+	EXPECT_EQ(schedule.vids.size(), 18u);
+}
+
+// test for the prefetch-ahead pipeline
+// prefetching only warms the caches, samples are the same with and without it
+TEST_F(SamplerTest, sample_prefetch) {
+	dd::VariableSchedule schedule;
+	schedule.build_inference(fg, false, 1);
+	fg.infrs->weight_values[0] = 0.5;
+
+	std::vector<int> initial(fg.infrs->assignments_evid, fg.infrs->assignments_evid + 18);
+	for (int i = 0; i < 3; i++) sampler.p_rand_seed[i] = 1;
+	sampler.sample(schedule, 0);
+	std::vector<int> expected(fg.infrs->assignments_evid, fg.infrs->assignments_evid + 18);
+
+	std::copy(initial.begin(), initial.end(), fg.infrs->assignments_evid);
+	fg.prefetch_distance = 2;
+	for (int i = 0; i < 3; i++) sampler.p_rand_seed[i] = 1;
+	sampler.sample(schedule, 0);
+	for (int i = 0; i < 18; i++) {
+		EXPECT_EQ(fg.infrs->assignments_evid[i], expected[i]);
+	}
+}
+
+// test for hub variables
+// a hub's potential summed over slices of its factors is sampled like the whole
+TEST_F(SamplerTest, sample_hubs) {
+	dd::VariableSchedule schedule;
+	schedule.build_inference(fg, false, 2);
+	schedule.split_hubs(fg, 2, 2);
+	EXPECT_EQ(schedule.hubs.size(), 0u);
+	schedule.split_hubs(fg, 1, 2);
+	EXPECT_EQ(schedule.hubs.size(), 9u);
+	EXPECT_EQ(schedule.vids.size(), 0u);
+	EXPECT_EQ(schedule.bounds[2], 0);
+
+	fg.infrs->weight_values[0] = 2;
+	dd::Variable & variable = fg.variables[10];
+	EXPECT_DOUBLE_EQ(fg.potential<false>(variable, 1, 0, 1), fg.potential<false>(variable, 1));
+	EXPECT_EQ(fg.potential<false>(variable, 1, 1, 1), 0.0);
+
+	for (int i = 0; i < 3; i++) sampler.p_rand_seed[i] = 1;
+	sampler.sample_single_variable(10);
+	const int expected = fg.infrs->assignments_evid[10];
+	for (int i = 0; i < 3; i++) sampler.p_rand_seed[i] = 1;
+	sampler.sample_single_variable(10, fg.potential<false>(variable, 0, 0, 1) + 
+		fg.potential<false>(variable, 0, 1, 1), fg.potential<false>(variable, 1, 0, 1));
+	EXPECT_EQ(fg.infrs->assignments_evid[10], expected);
+}
+
+// test for sample_sgd_minibatch
+// the minibatch is a permutation of the worker's range, in place, and
+// prefetching it does not change the batch or the weights
+TEST_F(SamplerTest, sample_sgd_minibatch) {
+	dd::VariableSchedule schedule;
+	schedule.build_learning(fg, false, 1);
+	std::vector<long> vids = schedule.vids;
+	EXPECT_EQ(schedule.batch_size(0, 0.5), 5);
+	EXPECT_EQ(schedule.batch_size(0, 0.01), 1);
+
+	fg.stepsize = 0.1;
+	const double weight = fg.infrs->weight_values[0];
+	for (int i = 0; i < 3; i++) sampler.p_rand_seed[i] = 1;
+	sampler.sample_sgd_minibatch(schedule, 0, 0.5);
+	const std::vector<long> batch = schedule.vids;
+	const double learned = fg.infrs->weight_values[0];
+	std::sort(schedule.vids.begin(), schedule.vids.end());
+	EXPECT_EQ(schedule.vids, vids);
+
+	schedule.vids = vids;
+	fg.infrs->weight_values[0] = weight;
+	fg.prefetch_distance = 1;
+	for (int i = 0; i < 3; i++) sampler.p_rand_seed[i] = 1;
+	sampler.sample_sgd_minibatch(schedule, 0, 0.5);
+	EXPECT_EQ(schedule.vids, batch);
+	EXPECT_DOUBLE_EQ(fg.infrs->weight_values[0], learned);
+}
+
+// test for VariableSchedule::split_holdout
+TEST_F(SamplerTest, variable_schedule_holdout) {
+	dd::VariableSchedule schedule;
+	schedule.build_learning(fg, false, 2);
+	std::vector<long> holdout = schedule.split_holdout(fg, 0.5, 2);
+
+	EXPECT_GT(holdout.size(), 0u);
+	EXPECT_EQ(holdout.size() + schedule.vids.size(), 9u);
+	EXPECT_EQ(schedule.bounds[2], (long)schedule.vids.size());
+	for (size_t k = 0; k < holdout.size(); k++) {
+		EXPECT_TRUE(fg.variables[holdout[k]].is_evid);
+		EXPECT_EQ(std::count(schedule.vids.begin(), schedule.vids.end(), holdout[k]), 0);
+	}
+}
+
+// test for sample_single_variable_chains
+// each chain adds one sample, and the chains start at random values
+TEST_F(SamplerTest, sample_single_variable_chains) {
+	fg.infrs->enable_chains(4);
+	fg.infrs->reset_chains(fg.variables, false);
+	for (int c = 0; c < 4; c++) {
+		EXPECT_EQ(fg.infrs->chains->get(0, c), fg.infrs->assignments_evid[0]);
+		EXPECT_EQ(dd::ChainView(*fg.infrs->chains, c)[0], fg.infrs->assignments_evid[0]);
+	}
+
+	fg.infrs->rao_blackwell = true;
+	fg.infrs->weight_values[0] = 2;
+	sampler.sample_single_variable_chains(10);
+	EXPECT_EQ(fg.infrs->agg_nsamples[10], 4);
+	EXPECT_DOUBLE_EQ(fg.infrs->agg_means[10], 4.0 / (1.0 + exp(-2.0)));
+	EXPECT_DOUBLE_EQ(fg.infrs->chain_means[10 * 4 + 3], 1.0 / (1.0 + exp(-2.0)));
+
+	// evidence is not sampled
+	sampler.sample_single_variable_chains(0);
+	EXPECT_EQ(fg.infrs->agg_nsamples[0], 0);
+}
+
+// test for cluster moves
+// four variables in a chain of strong EQUAL factors form one cluster that
+// flips as a whole, the evidence variable tied by a weak factor stays
+TEST(ClusterSamplerTest, sample) {
+	dd::FactorGraph fg(5, 4, 2, 8);
+	build_test_graph(fg, {false, false, false, false, true}, {50, -20}, {
+		{dd::FUNC_EQUAL, 0, {0, 1}}, {dd::FUNC_EQUAL, 0, {1, 2}}, 
+		{dd::FUNC_EQUAL, 0, {2, 3}}, {dd::FUNC_EQUAL, 1, {3, 4}}});
+
+	dd::ClusterSampler sampler(&fg, false);
+	int n_flipped = 0;
+	for (int k = 0; k < 20; k++) {
+		sampler.sample();
+		EXPECT_EQ(sampler.n_clusters, 1);
+		for (int i = 1; i < 4; i++) {
+			EXPECT_EQ(fg.infrs->assignments_evid[i], fg.infrs->assignments_evid[0]);
+		}
+		EXPECT_EQ(fg.infrs->assignments_evid[4], 0);
+		n_flipped += sampler.n_flipped;
+	}
+	// the cluster prefers to disagree with the evidence, which is false
+	EXPECT_EQ(fg.infrs->assignments_evid[0], 1);
+	EXPECT_GT(n_flipped, 0);
+}
@@ -0,0 +1,51 @@
+#include <vector>
+#include "dstruct/factor_graph/factor_graph.h"
+
+#ifndef _TEST_GRAPHS_H_
+#define _TEST_GRAPHS_H_
+
+/**
+ * A factor of a hand-built test graph: its function, weight and variables,
+ * with all members positive unless is_positive is given
+ */
+struct TestFactor {
+	int func_id;
+	long weight_id;
+	std::vector<long> vids;
+	std::vector<bool> is_positive;
+};
+
+/**
+ * Fills fg, constructed with the sizes of the given graph, with Boolean
+ * variables (evidence where is_evid), weights and factors, and builds its
+ * edge-based store. The evid assignment is evid_values, 0 where not given.
+ */
+inline void build_test_graph(dd::FactorGraph & fg, const std::vector<bool> & is_evid,
+	const std::vector<double> & weights, const std::vector<TestFactor> & factors,
+	const std::vector<dd::VariableValue> & evid_values = std::vector<dd::VariableValue>()) {
+	for (size_t i = 0; i < is_evid.size(); i++) {
+		fg.variables[i] = dd::Variable(i, DTYPE_BOOLEAN, is_evid[i], 0, 1, 0, false);
+	}
+	for (size_t i = 0; i < weights.size(); i++) {
+		fg.weights[i] = dd::Weight(i, weights[i], false);
+	}
+	for (size_t i = 0; i < factors.size(); i++) {
+		const TestFactor & f = factors[i];
+		fg.factors[i] = dd::Factor(i, f.weight_id, f.func_id, f.vids.size());
+		for (size_t j = 0; j < f.vids.size(); j++) {
+			const bool is_positive = f.is_positive.empty() || f.is_positive[j];
+			fg.factors[i].tmp_variables.push_back(dd::VariableInFactor(f.vids[j], j, is_positive));
+		}
+	}
+	fg.c_nvar = is_evid.size();
+	fg.c_nfactor = factors.size();
+	fg.c_nweight = weights.size();
+	fg.sort_by_id();
+	fg.organize_graph_by_edge();
+	fg.safety_check();
+	for (size_t i = 0; i < is_evid.size(); i++) {
+		fg.infrs->assignments_evid[i] = i < evid_values.size() ? evid_values[i] : 0;
+	}
+}
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * Unit tests for the variable schedules of the samplers
+ */
+
+#include "gtest/gtest.h"
+#include "dstruct/factor_graph/factor_graph.h"
+#include "app/gibbs/variable_schedule.h"
+#include "test_graphs.h"
+
+// test ordering the schedule by component, for the interleaved components
+// {v0, v2} and {v1, v3}, and removing one of them
+TEST(VariableScheduleTest, order_by_component) {
+	dd::FactorGraph fg(4, 2, 1, 4);
+	build_test_graph(fg, std::vector<bool>(4, false), {1.0}, {
+		{dd::FUNC_EQUAL, 0, {0, 2}}, {dd::FUNC_EQUAL, 0, {1, 3}}});
+
+	dd::VariableSchedule schedule;
+	schedule.build_inference(fg, false, 2);
+	schedule.order_by_component(fg, 2);
+	EXPECT_EQ(schedule.vids, std::vector<long>({0, 2, 1, 3}));
+	EXPECT_EQ(schedule.component_bounds, std::vector<long>({0, 2, 4}));
+	EXPECT_EQ(schedule.bounds, std::vector<long>({0, 2, 4}));
+
+	EXPECT_EQ(schedule.remove_components(fg, std::vector<bool>({true, false}), 2), 1);
+	EXPECT_EQ(schedule.vids, std::vector<long>({1, 3}));
+	EXPECT_EQ(schedule.component_bounds, std::vector<long>({0, 2}));
+}
+
+// test that the workers of a schedule in id order own whole 64-variable
+// words, and that a shared word is detected
+TEST(VariableScheduleTest, is_word_aligned) {
+	const long n = 300;
+	dd::FactorGraph fg(n, 0, 0, 0);
+	build_test_graph(fg, std::vector<bool>(n, false), {}, {});
+
+	dd::VariableSchedule schedule;
+	schedule.build_inference(fg, false, 3);
+	EXPECT_EQ(schedule.bounds.front(), 0);
+	EXPECT_EQ(schedule.bounds.back(), n);
+	for (int i = 1; i < 3; i++) {
+		EXPECT_EQ(schedule.bounds[i] % 64, 0);
+		EXPECT_GT(schedule.bounds[i], schedule.bounds[i-1]);
+	}
+	EXPECT_TRUE(schedule.is_word_aligned());
+
+	schedule.bounds = std::vector<long>({0, 100, n});
+	EXPECT_FALSE(schedule.is_word_aligned());
+}